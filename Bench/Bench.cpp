@@ -0,0 +1,270 @@
+/// \file Bench.cpp
+/// \brief Benchmark for the string generators and the turtle.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+//This is a console program that times the ways of doing the same work, for
+//each built-in L-system, at the first generation with at least
+//`BENCH_MIN_LEN` symbols. For a stochastic L-system the predicted length
+//is only an upper bound, so the generated length is measured instead:
+//
+//  - the LSystem rewriting one generation at a time, with its expansion
+//    cache turned off, which is how it runs for any rules given at run time,
+//    or for a stochastic L-system deriving the last generation from the root;
+//  - the LSystem generating from its expansion cache, as CMain uses it;
+//  - the compile-time specialization LPreset::Generate();
+//  - the turtle, made from a run-time descriptor and from one that points
+//    to the tables baked by LPreset, reading the generated string;
+//  - the baked turtle reading the string in parallel on all cores, or on 2
+//    threads if there is only one core, which is then all overhead;
+//  - for Branching at 8 to 10 generations, deriving the string on one
+//    thread, against making the keys that choose its productions on their
+//    own, one at a time and in blocks, to show what share of the time goes
+//    to the PRNG.
+//
+//Each time is the fastest of `BENCH_RUNS` runs. The results of the ways
+//being compared are checked to be the same. A turtle that reads in parallel
+//only gives the same segments as one that reads serially if it is on a
+//lattice, so otherwise it is checked against a turtle that reads on a
+//different number of threads, which must give the same segments.
+
+#include <chrono>
+
+#include "Preset.h"
+
+#define BENCH_MIN_LEN (1 << 22) ///< Shortest string to time.
+#define BENCH_RUNS 5 ///< Number of runs of each test.
+#define BENCH_TURTLES 10000 ///< Number of turtles made to time construction.
+#define BENCH_KEY_BLOCK 16 ///< Number of PRNG keys made at a time in blocks.
+
+/// Time a function.
+/// \param f Function to time.
+/// \return Fastest time of `BENCH_RUNS` calls, in milliseconds.
+
+template<class F> static double Time(F f){
+  double best = 0; //fastest time so far
+
+  for(int i=0; i<BENCH_RUNS; i++){
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+
+    const double t = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    if(i == 0 || t < best)best = t;
+  } //for
+
+  return best;
+} //Time
+
+/// Whether two turtles drew the same segments.
+/// \param a A segment buffer.
+/// \param b Another segment buffer.
+/// \return true if they are the same.
+
+static bool Same(const CSegments& a, const CSegments& b){
+  return a.m_vX0 == b.m_vX0 && a.m_vY0 == b.m_vY0 &&
+    a.m_vX1 == b.m_vX1 && a.m_vY1 == b.m_vY1 &&
+    a.m_vDepth == b.m_vDepth && a.m_vIndex == b.m_vIndex;
+} //Same
+
+/// Benchmark one built-in L-system.
+/// \tparam P Grammar class.
+/// \param name Name of the grammar.
+/// \return true if the results being compared were the same.
+
+template<class P> static bool Bench(const char* name){
+  typedef LPreset<P> L; //shorthand
+  bool ok = true; //result
+
+  LSystem lsys; //run-time L-system
+  L::SetRules(lsys);
+
+  UINT n = P::Generations(); //number of generations
+
+  if(L::IsStochastic()) //predicted length is an upper bound, so generate it
+    for(lsys.Generate(n); lsys.GetString().size() < BENCH_MIN_LEN; n++)
+      lsys.Generate(n + 1);
+
+  else while(lsys.GetPredictedLength(n) < BENCH_MIN_LEN)n++;
+
+  printf("%s: %u generations\n", name, n);
+
+  //string generators
+
+  std::string s; //generated string
+
+  if(L::IsStochastic()){ //only the LSystem can generate it
+    const double t = Time([&]{L::SetRules(lsys); lsys.Generate(n);});
+    printf("  LSystem derivation %9.2f ms\n", t);
+  } //if
+
+  else{
+    lsys.SetMemoize(false);
+    const double t0 = Time([&]{L::SetRules(lsys); lsys.Generate(n);});
+    const std::string s0 = lsys.GetString(); //rewritten
+
+    lsys.SetMemoize(true);
+    const double t1 = Time([&]{L::SetRules(lsys); lsys.Generate(n);});
+    const bool ok1 = lsys.GetString() == s0;
+
+    const double t2 = Time([&]{L::Generate(n, s);});
+    const bool ok2 = s == s0;
+
+    printf("  LSystem rewriting  %9.2f ms\n", t0);
+    printf("  LSystem cache      %9.2f ms  %s\n", t1, ok1? "same": "DIFFERENT");
+    printf("  LPreset::Generate  %9.2f ms  %s\n", t2, ok2? "same": "DIFFERENT");
+    ok = ok && ok1 && ok2;
+  } //else
+
+  s = lsys.GetString();
+  printf("  %zu symbols\n", s.size());
+
+  //turtle
+
+  const TurtleDesc d0(P::Angle(), P::Length()); //run-time descriptor
+  const TurtleDesc d1 = L::GetTurtleDesc(); //baked descriptor
+
+  CTurtle turtle0(d0); //run-time turtle
+  CTurtle turtle1(d1); //baked turtle
+
+  auto Read = [&](CTurtle& turtle){ //read the string
+    turtle.Reset();
+    turtle.Read(s.data(), s.size());
+  }; //Read
+
+  auto Make = [&](const TurtleDesc& d){ //make turtles
+    for(int i=0; i<BENCH_TURTLES; i++)
+      CTurtle turtle(d);
+  }; //Make
+
+  const double t0 = Time([&]{Make(d0);});
+  const double t1 = Time([&]{Make(d1);});
+  const double t2 = Time([&]{Read(turtle0);});
+  const double t3 = Time([&]{Read(turtle1);});
+  const bool ok3 = Same(turtle0.GetSegments(), turtle1.GetSegments());
+
+  printf("  %d turtles made at run time %9.2f ms\n", BENCH_TURTLES, t0);
+  printf("  %d turtles made from tables %9.2f ms\n", BENCH_TURTLES, t1);
+  printf("  turtle, run-time   %9.2f ms\n", t2);
+  printf("  turtle, baked      %9.2f ms  %s\n", t3, ok3? "same": "DIFFERENT");
+
+  //parallel turtle
+
+  const unsigned cores = std::thread::hardware_concurrency(); //number of cores
+  const unsigned threads = (cores > 2)? cores: 2; //threads to read on
+
+  CTurtle turtle2(d1); //parallel turtle
+  turtle2.SetThreads(threads);
+
+  CTurtle turtle3(d1); //parallel turtle on a different number of threads
+  turtle3.SetThreads(threads + 1);
+  Read(turtle3);
+
+  const double t4 = Time([&]{Read(turtle2);});
+  const bool ok4 = Same(turtle2.GetSegments(),
+    turtle2.IsLattice()? turtle1.GetSegments(): turtle3.GetSegments());
+
+  printf("  turtle, %2u threads %9.2f ms  %s\n", threads, t4,
+    ok4? "same": "DIFFERENT");
+
+  return ok && ok3 && ok4;
+} //Bench
+
+static volatile ULONGLONG g_nSink = 0; ///< Keeps results from being optimized out.
+
+/// Benchmark the stochastic Branching L-system at 8 to 10 generations, and
+/// the keys that choose its productions (see LSystem::Choose()). There is
+/// one key per rewritten symbol of each generation but the last. The keys
+/// are made with CRandom::SubKey() one at a time, as LSystem::Derive() makes
+/// them, and in blocks of `BENCH_KEY_BLOCK` written to a buffer and then
+/// read back, as a bulk fill would make them.
+
+static void BenchRandom(){
+  typedef LPreset<LPresetBranching> L; //shorthand
+
+  LSystem lsys; //run-time L-system
+  L::SetRules(lsys);
+
+  printf("Branching keys\n");
+
+  for(UINT n=8; n<=10; n++){
+    size_t keys = 0; //number of keys
+    lsys.SetSeed(0);
+
+    for(UINT k=0; k<n; k++){ //count rewritten symbols
+      lsys.Generate(k);
+      const std::string& s = lsys.GetString();
+      keys += std::count(s.begin(), s.end(), 'F');
+    } //for
+
+    const double t0 = Time([&]{lsys.SetSeed(0); lsys.Generate(n);});
+    const size_t len = lsys.GetString().size(); //number of symbols
+
+    ULONGLONG x = 0; //xor of keys, so that they are used
+
+    const double t1 = Time([&]{
+      for(size_t i=0; i<keys; i++)
+        x ^= CRandom::SubKey(i, 0);
+    }); //Time
+
+    const double t2 = Time([&]{
+      ULONGLONG block[BENCH_KEY_BLOCK]; //keys waiting to be used
+
+      for(size_t i=0; i<keys; i+=BENCH_KEY_BLOCK){
+        for(size_t j=0; j<BENCH_KEY_BLOCK; j++) //fill
+          block[j] = CRandom::SubKey(i, j);
+
+        for(size_t j=0; j<BENCH_KEY_BLOCK; j++) //use
+          x ^= block[j];
+      } //for
+    }); //Time
+
+    g_nSink = x;
+
+    printf("  %2u generations, %zu symbols, %zu keys\n", n, len, keys);
+    printf("    derivation       %9.2f ms\n", t0);
+    printf("    keys one by one  %9.2f ms  %4.1f%%\n", t1, 100*t1/t0);
+    printf("    keys in blocks   %9.2f ms  %4.1f%%\n", t2, 100*t2/t0);
+  } //for
+} //BenchRandom
+
+/// Benchmark every built-in L-system.
+/// \return 0 if the results being compared were the same, 1 otherwise.
+
+int main(){
+  bool ok = true; //whether everything matched
+
+  ok = Bench<LPresetBranching>("Branching") && ok;
+  ok = Bench<LPresetPlantA>("Plant A") && ok;
+  ok = Bench<LPresetPlantB>("Plant B") && ok;
+  ok = Bench<LPresetPlantC>("Plant C") && ok;
+  ok = Bench<LPresetPlantD>("Plant D") && ok;
+  ok = Bench<LPresetPlantE>("Plant E") && ok;
+  ok = Bench<LPresetPlantF>("Plant F") && ok;
+  ok = Bench<LPresetHexGosper>("Hexagonal Gosper") && ok;
+
+  BenchRandom();
+
+  return ok? 0: 1;
+} //main
@@ -25,6 +25,33 @@
 
 #include "CMain.h"
 #include "WindowsHelpers.h"
+#include "Preset.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Built-in L-systems
+
+#pragma region Built-in L-systems
+
+/// Call a generic function with an object of the grammar class, for example
+/// LPresetPlantA, for an L-system type. The function can then use the
+/// grammar's compile-time specialization LPreset.
+/// \param t L-system type, one of the `IDM_LSYS_*` menu ids.
+/// \param f Generic function that takes a grammar object.
+
+template<class F> static void ForPreset(const UINT t, F f){
+  switch(t){
+    case IDM_LSYS_BRANCHING: f(LPresetBranching()); break;
+    case IDM_LSYS_PLANT_A:   f(LPresetPlantA());    break;
+    case IDM_LSYS_PLANT_B:   f(LPresetPlantB());    break;
+    case IDM_LSYS_PLANT_C:   f(LPresetPlantC());    break;
+    case IDM_LSYS_PLANT_D:   f(LPresetPlantD());    break;
+    case IDM_LSYS_PLANT_E:   f(LPresetPlantE());    break;
+    case IDM_LSYS_PLANT_F:   f(LPresetPlantF());    break;
+    case IDM_LSYS_HEXGOSPER: f(LPresetHexGosper()); break;
+  } //switch
+} //ForPreset
+
+#pragma endregion Built-in L-systems
 
 ///////////////////////////////////////////////////////////////////////////////
 // Constructors and destructors
@@ -39,7 +66,7 @@
 /// \param hwnd Window handle.
 
 CMain::CMain(const HWND hwnd):
-  m_hWnd(hwnd)
+  m_hWnd(hwnd), m_cCache(RENDER_CACHE_BUDGET)
 {
   m_gdiplusToken = InitGDIPlus(); 
 
@@ -47,6 +74,8 @@ CMain::CMain(const HWND hwnd):
   m_pFont = new Gdiplus::Font(m_pFontFamily, 14, Gdiplus::FontStyleRegular,
     Gdiplus::UnitPixel);
 
+  m_cLSystem.SetThreads(m_nThreads); //use all cores
+  m_cLSystem.SetMemoryBudget(MEMORY_BUDGET); //spill longer generations
   SetRules(); //create the first set of rules
 
   //create and init menus
@@ -63,13 +92,15 @@ CMain::CMain(const HWND hwnd):
 
   //generate and draw the first object
   
+  NewSeed();
   Generate();
   Draw();
 } //constructor
 
-/// Delete all GDI+ objects, then shut down GDI+.
+/// Delete all GDI+ objects, including those in the cache, then shut down GDI+.
 
 CMain::~CMain(){
+  m_cCache.Clear();
   delete m_pBitmap;
   delete m_pFontFamily;
   delete m_pFont;
@@ -152,129 +183,232 @@ void CMain::DrawRules(Gdiplus::Graphics& graphics, Gdiplus::PointF p){
 
 /// Use turtle graphics to draw the shape corresponding to the generated string
 /// to `m_pBitmap`, which gets resized to the smallest rectangle containing all
-/// of the non-transparent pixels. This is done by doing turtle graphics twice,
-/// the first time without drawing but measuring the extents of the rectangle
-/// that gets drawn on. After measuring, the bitmap is resized and then a second
-/// iteration of turtle graphics is performed to draw the image.
+/// of the non-transparent pixels. The turtle itself is a CTurtle, which
+/// knows nothing about GDI+, and which records the segments that it draws
+/// and the rectangle that they cover.
+///
+/// Usually the turtle reads the string once, recording every segment, and
+/// then the bitmap is made to fit and the segments are drawn from the
+/// turtle's buffer. If the number of segments that LGrowth predicts is more
+/// than `ONE_PASS_SEGMENTS`, then that buffer would be too large, so the
+/// turtle reads the string twice instead: the first time only measuring,
+/// and the second time drawing the segments and discarding them after each
+/// batch of symbols.
+///
+/// If the L-system's last generation was deferred, then on each pass a
+/// producer thread streams it through a ring buffer of `STREAM_RING_SIZE`
+/// symbols while this thread runs the turtle. The two overlap, and the last
+/// generation never has to be stored in full. A result that was spilled to
+/// a file because it was too long for memory is streamed in the same way.
+/// If the L-system's result is compressed, then the turtle walks it
+/// directly instead.
+///
+/// The symbols are given to the turtle in batches of `TURTLE_BATCH_SIZE`,
+/// which is long enough for it to read each batch on all cores (see
+/// CTurtle::SetThreads()).
+///
+/// The segments and bounds from a one-pass read are put in the render
+/// cache as geometry, whose key is the bitmap's key without the line width.
+/// If the geometry is found there, then the turtle is not run at all, so
+/// changing the line width only draws the segments again.
 /// \param d Turtle graphics descriptor.
+/// \param key Cache key for the bitmap.
 
-void CMain::Draw(const TurtleDesc& d){
-  const std::wstring& s = m_cLSystem.GetString(); //shorthand for generated string
-  std::stack<StackFrame> stack; //stack frame
+void CMain::Draw(const TurtleDesc& d, const CRenderKey& key){
+  const bool bStream = m_cLSystem.IsDeferred() || m_cLSystem.IsSpilled(); //stream the string
+  const size_t BATCHSIZE = TURTLE_BATCH_SIZE; //number of symbols to read at a time
 
-  //prepare to draw
+  const double segments = LGrowth(m_cLSystem).GetSegments(
+    m_cLSystem.GetGenerations()); //expected number of segments
+  const bool bOnePass = segments <= ONE_PASS_SEGMENTS; //keep them all
 
+  CRenderKey geomkey = key; //cache key for the geometry
+  geomkey.m_nKind = RENDER_GEOMETRY;
+  geomkey.m_fPointSize = 0; //geometry does not depend on line width
+
+  const CRenderGeometry* pGeometry = m_cCache.FindGeometry(geomkey); //cached geometry
+
+  CTurtle turtle(d); //turtle graphics interpreter
+  turtle.SetThreads(m_nThreads); //use all cores
   Gdiplus::Graphics* pGraphics = nullptr;
 
-  Gdiplus::PointF ptCur; //current position, the start of the line
-    
   Gdiplus::Pen pen(Gdiplus::Color::Black);
   pen.SetWidth(d.m_fPointSize);
-  
-  //initialize the dirty rectangle to the start pixel
-
-  RECT r;
-
-  r.left   = int(std::floor(ptCur.X)); 
-  r.right  = int(std::ceil (ptCur.X)); 
-  r.top    = int(std::floor(ptCur.Y)); 
-  r.bottom = int(std::ceil (ptCur.Y)); 
-
-  //measure once, draw once
-
-  for(int i: {0, 1}){ //i==0 means measure, i==1 means draw
-    float angle = 0; //current orientation
-    float len = d.m_fLength; //current branch length
-
-    for(size_t j=0; j<s.size(); j++){ //loop through characters of s
-      Gdiplus::PointF ptNext; //next position (the end of the line)
-
-      switch(s[j]){ 
-        case 'L':
-        case 'R':
-        case 'F':
-          ptNext = ptCur - Gdiplus::PointF(-len*sinf(angle), len*cosf(angle));
-          
-          if(i == 0)AddPointToRect(r, ptNext); //measure
-          else pGraphics->DrawLine(&pen, ptCur, ptNext); //draw
-          
-          ptCur = ptNext;
-        break; 
-
-        case '+': angle -= d.m_fAngleDelta; break;
-        case '-': angle += d.m_fAngleDelta; break;
-
-        case '[': 
-          stack.push(StackFrame(ptCur, angle, len)); 
-          len *= d.m_fLenMultiplier;
-        break;
-
-        case ']': {
-          const StackFrame& sf = stack.top();
-          
-          ptCur = sf.m_ptPos;
-          angle = sf.m_fAngle;
-          len   = sf.m_fLength;
-
-          stack.pop(); //this must be last, obviously
-        } //case
-        break;
-      } //switch
-    } //for
-
-    if(i == 0){ //done measuring, prepare for drawing
-      
-      //make the bitmap slightly larger to include lines on the edge
 
-      const int delta = (int)std::ceil(d.m_fPointSize/2.0f); //amount to add
-      r.right  += delta;
-      r.bottom += delta;
+  //draw some segments
 
-      //create new bitmap of exactly the right size
+  auto DrawLines = [&](const CSegments& s){
+    for(size_t j=0; j<s.GetSize(); j++)
+      pGraphics->DrawLine(&pen, s.m_vX0[j], s.m_vY0[j], s.m_vX1[j], s.m_vY1[j]);
+  }; //DrawLines
 
-      const int w = r.right - r.left; //new bitmap width
-      const int h = r.bottom - r.top; //new bitmap height
-      ptCur = Gdiplus::PointF(-(float)r.left, -(float)r.top); //new start point
+  //draw the segments in the turtle's buffer, then forget them
 
-      //create bitmap and graphics object for drawing in the next iteration
-      delete m_pBitmap;
-      delete pGraphics;
+  auto DrawSegments = [&](){
+    DrawLines(turtle.GetSegments());
+    turtle.ClearSegments();
+  }; //DrawSegments
 
-      m_pBitmap = new Gdiplus::Bitmap(w, h, PixelFormat32bppARGB); 
-      pGraphics = new Gdiplus::Graphics(m_pBitmap);
+  //run the turtle over the whole string, calling f after each batch
 
-      pGraphics->SetSmoothingMode(Gdiplus::SmoothingModeHighQuality);
-      pGraphics->Clear(Gdiplus::Color::Transparent); //transparent background
+  auto Run = [&](const std::function<void()>& f){
+    auto Turtle = [&](const char* p, size_t n){ //process some characters
+      turtle.Read(p, n);
+      if(f)f();
+    }; //Turtle
+
+    if(bStream){ //read string from a producer thread
+      CRingBuffer<char> ring(STREAM_RING_SIZE); //string goes through here
+      std::thread producer([&](){m_cLSystem.Stream(ring);}); //start producer
+
+      std::vector<char> buffer(BATCHSIZE); //symbols popped from the ring
+      size_t n = 0; //number of symbols in buffer
+      size_t m = 0; //number of symbols popped
+
+      while((m = ring.Pop(&buffer[n], BATCHSIZE - n)) > 0){ //loop through characters
+        n += m;
+
+        if(n == BATCHSIZE){ //buffer is full
+          Turtle(buffer.data(), n);
+          n = 0;
+        } //if
+      } //while
+
+      Turtle(buffer.data(), n); //the remainder
+      producer.join();
     } //if
-  } //for
+
+    else if(m_cLSystem.IsCompressed()){ //walk the compressed string
+      std::vector<char> buffer(BATCHSIZE); //symbols waiting for the turtle
+      size_t n = 0; //number of symbols in buffer
+
+      m_cLSystem.GetCompressed().ForEach([&](const char c){
+        buffer[n++] = c;
+
+        if(n == BATCHSIZE){ //buffer is full
+          Turtle(buffer.data(), n);
+          n = 0;
+        } //if
+      }); //ForEach
+
+      Turtle(buffer.data(), n); //the remainder
+    } //else if
+
+    else{ //all at once
+      const std::string& s = m_cLSystem.GetString(); //the string
+
+      for(size_t j=0; j<s.size(); j+=BATCHSIZE)
+        Turtle(s.data() + j, min(BATCHSIZE, s.size() - j));
+    } //else
+  }; //Run
+
+  //read the string, recording the segments if there is room for them
+
+  float left, top, right, bottom; //bounds of the drawing
+
+  if(pGeometry){ //already read
+    left = pGeometry->m_fLeft;
+    top = pGeometry->m_fTop;
+    right = pGeometry->m_fRight;
+    bottom = pGeometry->m_fBottom;
+  } //if
+
+  else{ //run the turtle
+    if(bOnePass)turtle.Reserve((size_t)segments);
+    else turtle.SetRecord(false); //measuring needs only the bounds
+
+    Run(nullptr);
+    turtle.GetBounds(left, top, right, bottom);
+
+    if(bOnePass) //keep the geometry
+      m_cCache.InsertGeometry(geomkey, turtle.GetSegments(), left, top, right,
+        bottom);
+  } //else
+
+  //make a bitmap of exactly the right size
+
+  RECT r; //dirty rectangle
+
+  r.left   = int(std::floor(left)); 
+  r.right  = int(std::ceil (right)); 
+  r.top    = int(std::floor(top)); 
+  r.bottom = int(std::ceil (bottom)); 
+      
+  //make the bitmap slightly larger to include lines on the edge
+
+  const int delta = (int)std::ceil(d.m_fPointSize/2.0f); //amount to add
+  r.right  += delta;
+  r.bottom += delta;
+
+  const int w = r.right - r.left; //new bitmap width
+  const int h = r.bottom - r.top; //new bitmap height
+
+  delete m_pBitmap;
+  m_pBitmap = new Gdiplus::Bitmap(w, h, PixelFormat32bppARGB); 
+  pGraphics = new Gdiplus::Graphics(m_pBitmap);
+
+  pGraphics->SetSmoothingMode(Gdiplus::SmoothingModeHighQuality);
+  pGraphics->Clear(Gdiplus::Color::Transparent); //transparent background
+
+  //draw
+
+  if(pGeometry){ //from the cache, moved so that the top left is at the origin
+    pGraphics->TranslateTransform(-(float)r.left, -(float)r.top);
+    DrawLines(pGeometry->m_cSegments);
+  } //if
+
+  else if(bOnePass){ //from the buffer, moved so that the top left is at the origin
+    pGraphics->TranslateTransform(-(float)r.left, -(float)r.top);
+    DrawSegments();
+  } //else if
+
+  else{ //read the string again, drawing as we go
+    turtle.Reset(-(float)r.left, -(float)r.top); //new start point
+    turtle.SetRecord(true); //drawing needs the segments
+    Run(DrawSegments);
+  } //else
 
   delete pGraphics; //clean up
 } //Draw
 
 /// Use turtle graphics to draw the shape corresponding to the generated string
 /// to `m_pBitmap`, which gets resized to the smallest rectangle containing all
-/// of the non-transparent pixels. This function constructs a hard-coded turtle
-/// graphics descriptor appropriate to the current type stored in `m_nType` and
-/// then calls Draw(const TurtleDesc&) to do the actual work.
+/// of the non-transparent pixels. This function gets the compile-time turtle
+/// graphics descriptor of the current type stored in `m_nType` and then
+/// calls Draw(const TurtleDesc&, const CRenderKey&) to do the actual work, unless the bitmap is
+/// in the render cache. The cache key is made from the string's key,
+/// the turtle graphics descriptor, which includes the line width, and
+/// whether the turtle reads in parallel.
 
 void CMain::Draw(){
   TurtleDesc d; //turtle graphics descriptor
 
-  switch(m_nType){ //the angle deltas are cribbed from ABOP
-    case IDM_LSYS_PLANT_A: d = TurtleDesc(22.7f, 8.0f);  break;
-    case IDM_LSYS_PLANT_B: d = TurtleDesc(20.0f, 20.0f); break;
-    case IDM_LSYS_PLANT_C: d = TurtleDesc(22.5f, 12.0f); break;
-    case IDM_LSYS_PLANT_D: d = TurtleDesc(20.0f, 5.0f);  break;
-    case IDM_LSYS_PLANT_E: d = TurtleDesc(25.7f, 5.0f);  break;
-    case IDM_LSYS_PLANT_F: d = TurtleDesc(22.5f, 16.0f); break;
-
-    case IDM_LSYS_BRANCHING: d = TurtleDesc(21.2f, 8.0f); break;
-    case IDM_LSYS_HEXGOSPER: d = TurtleDesc(60.0f, 12.0f); break;
-  } //switch
+  ForPreset(m_nType, [&](auto p){ //the angle deltas are cribbed from ABOP
+    d = LPreset<decltype(p)>::GetTurtleDesc();});
   
   d.m_fPointSize = m_bThickLines? 2.0f: 1.0f;
 
-  Draw(d);
+  CRenderKey key = m_cStringKey; //cache key
+  key.m_nKind = RENDER_BITMAP;
+  key.m_fAngleDelta = d.m_fAngleDelta;
+  key.m_fLength = d.m_fLength;
+  key.m_fLenMultiplier = d.m_fLenMultiplier;
+  key.m_fPointSize = d.m_fPointSize;
+  key.m_bParallel = m_nThreads > 1;
+
+  Gdiplus::Bitmap* pCached = m_cCache.FindBitmap(key); //cached bitmap
+
+  if(pCached){ //cache hit
+    delete m_pBitmap;
+    m_pBitmap = pCached->Clone(0, 0, pCached->GetWidth(), 
+      pCached->GetHeight(), PixelFormat32bppARGB);
+  } //if
+
+  else{ //cache miss
+    Draw(d, key);
+    m_cCache.InsertBitmap(key, m_pBitmap);
+  } //else
+
   InvalidateRect(m_hWnd, nullptr, TRUE);
 } //Draw
 
@@ -368,60 +502,13 @@ void CMain::EnableGenerateMenuEntry(){
 #pragma region Settings functions
 
 /// Set rules for the current L-system type. The rules are hard-coded from ABOP
-/// using a long switch statement. Exercise for the reader: add your favorite
-/// L-system rules from ABOP. More difficult exercise: add the ability to read
-/// custom rules from a text or XML file.
+/// as the grammar classes in Preset.h. Exercise for the reader: add your
+/// favorite L-system rules from ABOP. More difficult exercise: add the ability
+/// to read custom rules from a text or XML file.
 
 void CMain::SetRules(){
-  m_cLSystem.Clear();
-
-  switch(m_nType){
-    case IDM_LSYS_BRANCHING:
-      m_cLSystem.SetRoot(L"F");
-      m_cLSystem.AddRule(LProduction(L'F', L"F[+F]F[-F]F", 0.33f));
-      m_cLSystem.AddRule(LProduction(L'F', L"F[+F]F", 0.33f));
-      m_cLSystem.AddRule(LProduction(L'F', L"F[-F]F", 0.34f));
-      break;
-
-    case IDM_LSYS_PLANT_A:
-      m_cLSystem.SetRoot(L"F");
-      m_cLSystem.AddRule(LProduction(L'F', L"F[+F]F[-F]F"));
-      break;
-
-    case IDM_LSYS_PLANT_B:
-      m_cLSystem.SetRoot(L"F");
-      m_cLSystem.AddRule(LProduction(L'F', L"F[+F]F[-F][F]"));
-      break;
-
-    case IDM_LSYS_PLANT_C:
-      m_cLSystem.SetRoot(L"F");
-      m_cLSystem.AddRule(LProduction(L'F', L"FF-[-F+F+F]+[+F-F-F]"));
-      break;
-
-    case IDM_LSYS_PLANT_D:
-      m_cLSystem.SetRoot(L"X");
-      m_cLSystem.AddRule(LProduction(L'X', L"F[+X]F[-X]+X"));
-      m_cLSystem.AddRule(LProduction(L'F', L"FF"));
-      break;
-
-    case IDM_LSYS_PLANT_E:
-      m_cLSystem.SetRoot(L"X");
-      m_cLSystem.AddRule(LProduction(L'X', L"F[+X][-X]FX"));
-      m_cLSystem.AddRule(LProduction(L'F', L"FF"));
-      break;
-
-    case IDM_LSYS_PLANT_F:
-      m_cLSystem.SetRoot(L"X");  
-      m_cLSystem.AddRule(LProduction(L'X', L"F-[ [X]+X]+F[+FX]-X"));
-      m_cLSystem.AddRule(LProduction(L'F', L"FF"));
-      break;
-
-    case IDM_LSYS_HEXGOSPER:
-      m_cLSystem.SetRoot(L"L");
-      m_cLSystem.AddRule(LProduction(L'L', L"L+R++R-L--LL-R+"));
-      m_cLSystem.AddRule(LProduction(L'R', L"-L+RR++R+L--L-R"));
-      break;
-  } //switch
+  ForPreset(m_nType, [&](auto p){
+    LPreset<decltype(p)>::SetRules(m_cLSystem);});
 } //SetRules
 
 /// Set the L-system type, set the checkmarks on the `L-System` menu to indicate
@@ -469,24 +556,72 @@ void CMain::ToggleShowRules(){
 // Other functions
 
 /// Generate an L-system string for a hard-coded number of generations.
+/// Stochastic L-systems are seeded with `m_nSeed` first, and if the string is
+/// predicted to have at least `STREAM_MIN_LEN` symbols, then the last
+/// generation is deferred so that Draw() can stream it. Deterministic strings
+/// that long are stored compressed (see LSystem::Compress()). Shorter ones
+/// are generated by `m_cLSystem`, which expands them from its cache and
+/// can start from its previous result or a checkpoint.
+///
+/// Stochastic generations too long for `MEMORY_BUDGET` are spilled to files
+/// by `m_cLSystem` (see LSystem::SetMemoryBudget()).
+///
+/// The string is looked up in the render cache first, and put there if it
+/// was not found (unless it was deferred, compressed, or spilled). The cache
+/// key is made from the hash of the root and rules, the number of
+/// generations, and, if the L-system is stochastic, the seed. It is kept in
+/// `m_cStringKey` so that Draw() can make keys for the geometry and bitmap.
 
 void CMain::Generate(){
   int nNumGenerations = 0; //number of generations
 
-  switch(m_nType){
-    case IDM_LSYS_PLANT_A:    nNumGenerations = 5; break;
-    case IDM_LSYS_PLANT_B:    nNumGenerations = 5; break;
-    case IDM_LSYS_PLANT_C:    nNumGenerations = 5; break;
-    case IDM_LSYS_PLANT_D:    nNumGenerations = 7; break;
-    case IDM_LSYS_PLANT_E:    nNumGenerations = 7; break;
-    case IDM_LSYS_PLANT_F:    nNumGenerations = 5; break;
-    case IDM_LSYS_BRANCHING:  nNumGenerations = 6; break;
-    case IDM_LSYS_HEXGOSPER:  nNumGenerations = 5; break;  
-  } //switch
+  ForPreset(m_nType, [&](auto p){
+    nNumGenerations = decltype(p)::Generations();});
   
-  m_cLSystem.Generate(nNumGenerations);
+  const bool bStochastic = m_cLSystem.IsStochastic(); //shorthand
+  const int seed = bStochastic? m_nSeed: 0; //seed, if it matters
+
+  CRenderKey key; //cache key
+  key.m_nKind = RENDER_STRING;
+  key.m_nRules = m_cLSystem.GetHash();
+  key.m_nGenerations = nNumGenerations;
+  key.m_nSeed = seed;
+  m_cStringKey = key;
+
+  const std::string* pCached = m_cCache.FindString(key); //cached string
+
+  if(pCached) //cache hit
+    m_cLSystem.SetResult(*pCached, nNumGenerations);
+
+  else{ //cache miss
+    if(bStochastic)
+      m_cLSystem.SetSeed(m_nSeed);
+
+    const size_t len = m_cLSystem.GetPredictedLength(nNumGenerations);
+    const bool bLong = len >= STREAM_MIN_LEN; //too long to store flat
+
+    if(bStochastic) //stream the last generation if it is long
+      m_cLSystem.Generate(nNumGenerations, bLong);
+
+    else if(bLong) //store it compressed
+      m_cLSystem.Compress(nNumGenerations);
+
+    else m_cLSystem.Generate(nNumGenerations);
+
+    if(!m_cLSystem.IsDeferred() && !m_cLSystem.IsCompressed() &&
+      !m_cLSystem.IsSpilled())
+      m_cCache.InsertString(key, m_cLSystem.GetString());
+  } //else
 } //Generate
 
+/// Choose a new seed for stochastic L-systems from the timer, so that the
+/// next call to Generate() generates a new string instead of finding the
+/// previous one in the render cache.
+
+void CMain::NewSeed(){
+  m_nSeed = int(timeGetTime() & 0x7FFFFFFF);
+} //NewSeed
+
 /// Reader function for the bitmap pointer `m_pBitmap` which, it is assumed,
 /// contains a bitmap drawn by turtle graphics from a string generated by
 /// an L-system.
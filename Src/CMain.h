@@ -30,6 +30,15 @@
 
 #include "WindowsHelpers.h"
 #include "Lsystem.h"
+#include "Growth.h"
+#include "RenderCache.h"
+
+#define STREAM_MIN_LEN (1 << 20) ///< Shortest string to stream to the turtle.
+#define STREAM_RING_SIZE (1 << 16) ///< Ring buffer size for streaming.
+#define RENDER_CACHE_BUDGET (256 << 20) ///< Render cache size in bytes.
+#define MEMORY_BUDGET (1 << 30) ///< Longest generation kept in memory.
+#define ONE_PASS_SEGMENTS (1 << 22) ///< Most segments drawn in one turtle pass.
+#define TURTLE_BATCH_SIZE (1 << 20) ///< Symbols given to the turtle at a time.
 
 /// \brief The main class.
 ///
@@ -49,6 +58,10 @@ class CMain{
     Gdiplus::Bitmap* m_pBitmap = nullptr; ///< Pointer to a bitmap image.
 
     LSystem m_cLSystem; ///< The L-system.
+    UINT m_nThreads = std::thread::hardware_concurrency(); ///< Cores to use.
+    CRenderCache m_cCache; ///< Cache of strings, geometry, and bitmaps.
+    int m_nSeed = 0; ///< Seed for stochastic L-systems.
+    CRenderKey m_cStringKey; ///< Cache key for the generated string.
 
     UINT m_nType = IDM_LSYS_PLANT_A; ///< Current L-system type.
     bool m_bThickLines = false; ///< Line thickness flag.
@@ -59,7 +72,7 @@ class CMain{
 
     void SetRules(); ///< Create the L-system rules.
     
-    void Draw(const TurtleDesc& d); ///< Draw turtle graphics.
+    void Draw(const TurtleDesc& d, const CRenderKey& key); ///< Draw turtle graphics.
     void DrawRules(Gdiplus::Graphics& graphics, Gdiplus::PointF p); ///< Draw rules.
 
     void CreateMenus(); ///< Create menus.
@@ -74,6 +87,7 @@ class CMain{
 
     void Draw(); ///< Draw turtle graphics.
     void Generate(); ///< Generate L-system string.
+    void NewSeed(); ///< Choose a new seed for stochastic L-systems.
 
     void OnPaint(); ///< Paint the client area.
     void SetType(UINT t); ///< Set type.
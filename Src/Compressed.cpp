@@ -0,0 +1,344 @@
+/// \file Compressed.cpp
+/// \brief Code for the grammar-compressed string LCompressed.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "Compressed.h"
+#include "Lsystem.h"
+#include "Types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Build functions
+
+#pragma region Build functions
+
+/// Build the DAG for generation \f$n\f$ of a deterministic L-system. The
+/// nodes are made one generation at a time, starting with a leaf for each
+/// symbol. The node for the expansion of a symbol \f$a\f$ after \f$k\f$
+/// generations has as children the nodes for the symbols of its right-hand
+/// side after \f$k - 1\f$ generations. Constants are always leaves. Lengths
+/// saturate at `SIZE_MAX`. If the L-system is stochastic then the DAG is
+/// left empty.
+/// \param lsys A deterministic L-system.
+/// \param n The number of generations.
+
+void LCompressed::Build(const LSystem& lsys, UINT n){
+  Clear();
+  if(lsys.IsStochastic())return; //no DAG
+
+  const UINT NONE = UINT_MAX; //no node
+  std::vector<UINT> leaf(NUM_LSYMBOLS, NONE); //leaf for each symbol
+  std::vector<UINT> prev(NUM_LSYMBOLS, NONE); //nodes one generation earlier
+  std::vector<UINT> cur(NUM_LSYMBOLS, NONE); //nodes for this generation
+
+  //get the node for symbol c from table v, making a leaf if needed
+
+  auto Child = [&](const std::vector<UINT>& v, const char c){
+    const UINT a = (unsigned char)c; //index of c
+
+    if(v[a] != NONE)return v[a]; //expanded symbol
+
+    if(leaf[a] == NONE){ //first time c is a leaf
+      Node leafnode; //new leaf
+      leafnode.m_nLength = 1;
+      leafnode.m_chSymbol = c;
+      leaf[a] = (UINT)m_vNode.size();
+      m_vNode.push_back(leafnode);
+    } //if
+
+    return leaf[a];
+  }; //Child
+
+  //make a node whose children are the nodes in table v of a string
+
+  auto Make = [&](const std::vector<UINT>& v, const char* p, size_t len){
+    Node node; //new node
+    node.m_nFirst = (UINT)m_vChild.size();
+    node.m_nCount = (UINT)len;
+
+    for(size_t i=0; i<len; i++){ //for each symbol
+      const UINT child = Child(v, p[i]);
+      const size_t m = m_vNode[child].m_nLength; //length of child
+      node.m_nLength = (node.m_nLength > SIZE_MAX - m)? SIZE_MAX:
+        node.m_nLength + m;
+      m_vChild.push_back(child);
+    } //for
+
+    m_vNode.push_back(node);
+    return (UINT)m_vNode.size() - 1;
+  }; //Make
+
+  const char* arena = lsys.m_strArena.data(); //right-hand sides
+
+  for(UINT k=1; k<=n; k++){ //for each generation
+    for(UINT a=0; a<NUM_LSYMBOLS; a++){ //for each symbol with productions
+      const LRuleRange& r = lsys.m_cRuleTable[a]; //table entry for a
+
+      if(r.m_nCount > 0){ //a is rewritten
+        const LCompiledRule& rule = lsys.m_vCompiled[r.m_nFirst];
+        cur[a] = Make(prev, arena + rule.m_nOffset, rule.m_nLength);
+      } //if
+    } //for
+
+    prev.swap(cur);
+  } //for
+
+  const std::string& root = lsys.m_strRoot; //shorthand
+  Make(prev, root.data(), root.size()); //the root is the last node
+} //Build
+
+/// Discard all nodes, leaving an empty string.
+
+void LCompressed::Clear(){
+  m_vNode.clear();
+  m_vChild.clear();
+} //Clear
+
+#pragma endregion Build functions
+
+///////////////////////////////////////////////////////////////////////////////
+// Reader functions
+
+#pragma region Reader functions
+
+/// Get the index of the root node, which is the last one made by Build().
+/// \return Index of the root node.
+
+UINT LCompressed::GetRoot() const{
+  return (UINT)m_vNode.size() - 1;
+} //GetRoot
+
+/// Get the length of the string, which is the length of the root node.
+/// \return The length of the string.
+
+size_t LCompressed::GetLength() const{
+  return m_vNode.empty()? 0: m_vNode.back().m_nLength;
+} //GetLength
+
+/// Get the number of nodes, which is a measure of the memory used.
+/// \return The number of nodes in the DAG.
+
+size_t LCompressed::GetNodeCount() const{
+  return m_vNode.size();
+} //GetNodeCount
+
+/// Get a symbol by descending from the root. At each node the children
+/// whose expansions come entirely before the target are skipped, so this
+/// takes time proportional to the number of generations times the length of
+/// the right-hand sides.
+/// \param k Index of a symbol, starting at zero.
+/// \param c [out] The symbol at index \f$k\f$, if there is one.
+/// \return true if there is such a symbol, false if there are \f$k\f$ or
+/// fewer symbols.
+
+bool LCompressed::GetSymbol(size_t k, char& c) const{
+  if(k >= GetLength())return false; //out of range
+
+  const Node* p = &m_vNode[GetRoot()]; //current node
+
+  while(p->m_nCount > 0){ //until a leaf is reached
+    UINT i = p->m_nFirst; //index of child
+
+    while(k >= m_vNode[m_vChild[i]].m_nLength){ //skip children before target
+      k -= m_vNode[m_vChild[i]].m_nLength;
+      i++;
+    } //while
+
+    p = &m_vNode[m_vChild[i]];
+  } //while
+
+  c = p->m_chSymbol;
+  return true;
+} //GetSymbol
+
+/// Append part of the string to another string. The range is clipped to the
+/// end of the string.
+/// \param first Index of the first symbol, starting at zero.
+/// \param count Number of symbols.
+/// \param s [in, out] String to append to.
+
+void LCompressed::GetSlice(size_t first, size_t count, std::string& s) const{
+  const size_t len = GetLength(); //length of string
+  if(first >= len)return; //nothing to do
+
+  count = min(count, len - first);
+  s.reserve(s.size() + count);
+  GetSlice(GetRoot(), first, count, s);
+} //GetSlice
+
+/// Append part of the expansion of a node to a string. Children entirely
+/// outside the range are skipped and the rest are copied recursively.
+/// \param node Index of a node.
+/// \param first Index of the first symbol in the node's expansion.
+/// \param count Number of symbols, which must all be in the node's expansion.
+/// \param s [in, out] String to append to.
+
+void LCompressed::GetSlice(UINT node, size_t first, size_t count,
+  std::string& s) const{
+  const Node& v = m_vNode[node]; //the node
+
+  if(v.m_nCount == 0) //leaf
+    s.push_back(v.m_chSymbol);
+
+  else for(UINT i=v.m_nFirst; count>0; i++){ //for each child in range
+    const UINT child = m_vChild[i]; //index of child
+    const size_t len = m_vNode[child].m_nLength; //length of child
+
+    if(first >= len) //child is before the range
+      first -= len;
+
+    else{ //child overlaps the range
+      const size_t n = min(count, len - first); //symbols from this child
+      GetSlice(child, first, n, s);
+      first = 0;
+      count -= n;
+    } //else
+  } //for
+} //GetSlice
+
+/// Hash the symbols with the 64-bit FNV-1a hash without making the string.
+/// The result is the same as HashBytes() applied to the string.
+/// \return The hash.
+
+ULONGLONG LCompressed::GetHash() const{
+  ULONGLONG h = FNV_OFFSET; //hash
+
+  ForEach([&](const char c){
+    h = HashBytes(&c, 1, h);
+  }); //ForEach
+
+  return h;
+} //GetHash
+
+/// Get an iterator to the first symbol.
+/// \return Iterator to the first symbol.
+
+LCompressed::Iterator LCompressed::begin() const{
+  return Iterator(this, false);
+} //begin
+
+/// Get an iterator past the last symbol.
+/// \return Iterator past the last symbol.
+
+LCompressed::Iterator LCompressed::end() const{
+  return Iterator(this, true);
+} //end
+
+#pragma endregion Reader functions
+
+///////////////////////////////////////////////////////////////////////////////
+// Iterator
+
+#pragma region Iterator
+
+/// Construct an iterator to the first symbol or past the last one.
+/// \param p Pointer to a compressed string.
+/// \param bEnd true for an iterator past the last symbol.
+
+LCompressed::Iterator::Iterator(const LCompressed* p, bool bEnd):
+  m_pOwner(p){
+  if(bEnd || p->m_vNode.empty())
+    m_nIndex = p->GetLength();
+
+  else{ //start at the root and go down to the first leaf
+    const UINT root = p->GetRoot(); //index of root node
+    m_vStack.push_back(std::make_pair(root, p->m_vNode[root].m_nFirst));
+    Descend();
+  } //else
+} //constructor
+
+/// Go down to the next leaf. The top of the stack is a node together with
+/// the index in `m_vChild` of its next child to visit. Children with empty
+/// expansions are skipped, and nodes whose children are used up are popped.
+
+void LCompressed::Iterator::Descend(){
+  const std::vector<Node>& node = m_pOwner->m_vNode; //shorthand
+  const std::vector<UINT>& child = m_pOwner->m_vChild; //shorthand
+
+  while(!m_vStack.empty()){
+    std::pair<UINT, UINT>& top = m_vStack.back(); //top of stack
+    const Node& v = node[top.first]; //node at top of stack
+
+    if(v.m_nCount == 0)return; //reached a leaf
+
+    if(top.second == v.m_nFirst + v.m_nCount){ //children used up
+      m_vStack.pop_back();
+      if(!m_vStack.empty())m_vStack.back().second++; //parent's next child
+    } //if
+
+    else{ //visit next child
+      const UINT c = child[top.second]; //index of child
+      if(node[c].m_nLength == 0)top.second++; //empty, skip it
+      else m_vStack.push_back(std::make_pair(c, node[c].m_nFirst));
+    } //else
+  } //while
+} //Descend
+
+/// Get the current symbol.
+/// \return Reference to the current symbol.
+
+LCompressed::Iterator::reference LCompressed::Iterator::operator*() const{
+  return m_pOwner->m_vNode[m_vStack.back().first].m_chSymbol;
+} //operator*
+
+/// Move to the next symbol.
+/// \return Reference to this iterator.
+
+LCompressed::Iterator& LCompressed::Iterator::operator++(){
+  m_nIndex++;
+  m_vStack.pop_back(); //pop the leaf
+
+  if(!m_vStack.empty()){ //move on to the next child
+    m_vStack.back().second++;
+    Descend();
+  } //if
+
+  return *this;
+} //operator++
+
+/// Move to the next symbol.
+/// \return A copy of this iterator from before the move.
+
+LCompressed::Iterator LCompressed::Iterator::operator++(int){
+  Iterator it = *this; //copy
+  ++*this;
+  return it;
+} //operator++
+
+/// Iterators are equal if they are at the same index of the same string.
+/// \param it An iterator.
+/// \return true if they are equal.
+
+bool LCompressed::Iterator::operator==(const Iterator& it) const{
+  return m_pOwner == it.m_pOwner && m_nIndex == it.m_nIndex;
+} //operator==
+
+/// Iterators are equal if they are at the same index of the same string.
+/// \param it An iterator.
+/// \return true if they are not equal.
+
+bool LCompressed::Iterator::operator!=(const Iterator& it) const{
+  return !(*this == it);
+} //operator!=
+
+#pragma endregion Iterator
@@ -0,0 +1,151 @@
+/// \file Compressed.h
+/// \brief Interface for the grammar-compressed string LCompressed.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#pragma once
+
+#include "Includes.h"
+
+class LSystem;
+
+///////////////////////////////////////////////////////////////////////////////
+// class LCompressed
+
+#pragma region LCompressed
+
+/// \brief Grammar-compressed generation of a deterministic L-system.
+///
+/// A generation stored as a directed acyclic graph instead of as a string.
+/// Every node other than the root stands for the expansion of one symbol
+/// after some number of generations. A leaf is a single symbol, either a
+/// constant or a symbol that is not expanded any further. An internal node
+/// is the expansion of a symbol \f$a\f$ after \f$k > 0\f$ generations, and
+/// its children are the nodes for the symbols of the right-hand side of the
+/// production for \f$a\f$ after \f$k - 1\f$ generations. The root's
+/// children are the nodes for the symbols of the L-system's root after
+/// \f$n\f$ generations. Each node stores the length of its expansion.
+///
+/// There is at most one node per symbol and number of generations, so the
+/// memory used grows with the number of productions times the number of
+/// generations, whereas the length of the string grows exponentially. The
+/// symbols can still be read in order with an Iterator or ForEach(), read at
+/// any index with GetSymbol(), copied out a range at a time with GetSlice(),
+/// and hashed with GetHash(), all without making the whole string.
+
+class LCompressed{
+  private:
+    /// \brief DAG node.
+    ///
+    /// The expansion of a symbol. Its children are listed in `m_vChild`.
+
+    class Node{
+      public:
+        size_t m_nLength = 0; ///< Length of expansion.
+        UINT m_nFirst = 0; ///< Index of first child in `m_vChild`.
+        UINT m_nCount = 0; ///< Number of children, zero for a leaf.
+        char m_chSymbol = '\0'; ///< Symbol, for a leaf.
+    }; //Node
+
+    std::vector<Node> m_vNode; ///< Nodes, with the root last.
+    std::vector<UINT> m_vChild; ///< Children of all nodes.
+
+    UINT GetRoot() const; ///< Get index of root node.
+    void GetSlice(UINT node, size_t first, size_t count, std::string& s) const; ///< Get part of a node.
+
+    /// \brief Apply a function to the symbols of a node.
+    ///
+    /// A node with an empty expansion, such as that of a symbol whose
+    /// production has an empty right-hand side, or the root of an empty
+    /// string, has no children but is not a leaf, so it is skipped, as it
+    /// is by an Iterator.
+    /// \tparam F Type of function taking a char.
+    /// \param node Index of a node.
+    /// \param f Function to apply to each symbol in order.
+
+    template<class F> void ForEach(UINT node, F& f) const{
+      const Node& v = m_vNode[node]; //the node
+
+      if(v.m_nLength == 0)return; //empty expansion
+
+      if(v.m_nCount == 0)f(v.m_chSymbol); //leaf
+
+      else for(UINT i=v.m_nFirst; i<v.m_nFirst + v.m_nCount; i++)
+        ForEach(m_vChild[i], f);
+    } //ForEach
+
+  public:
+    /// \brief Forward iterator.
+    ///
+    /// Reads the symbols in order by a depth-first walk of the DAG, with an
+    /// explicit stack of nodes and the index of the child being read in each.
+
+    class Iterator{
+      private:
+        const LCompressed* m_pOwner = nullptr; ///< The compressed string.
+        std::vector<std::pair<UINT, UINT>> m_vStack; ///< Nodes and children.
+        size_t m_nIndex = 0; ///< Index of current symbol.
+
+        void Descend(); ///< Go down to the next leaf.
+
+      public:
+        typedef std::forward_iterator_tag iterator_category; ///< Category.
+        typedef char value_type; ///< Value type.
+        typedef std::ptrdiff_t difference_type; ///< Difference type.
+        typedef const char* pointer; ///< Pointer type.
+        typedef const char& reference; ///< Reference type.
+
+        Iterator(){}; ///< Default constructor.
+        Iterator(const LCompressed* p, bool bEnd); ///< Constructor.
+
+        reference operator*() const; ///< Current symbol.
+        Iterator& operator++(); ///< Prefix increment.
+        Iterator operator++(int); ///< Postfix increment.
+
+        bool operator==(const Iterator& it) const; ///< Equality.
+        bool operator!=(const Iterator& it) const; ///< Inequality.
+    }; //Iterator
+
+    void Build(const LSystem& lsys, UINT n); ///< Build from an L-system.
+    void Clear(); ///< Make empty.
+
+    size_t GetLength() const; ///< Get length.
+    size_t GetNodeCount() const; ///< Get number of nodes.
+    bool GetSymbol(size_t k, char& c) const; ///< Get symbol at index.
+    void GetSlice(size_t first, size_t count, std::string& s) const; ///< Get part.
+    ULONGLONG GetHash() const; ///< Hash of the symbols.
+
+    Iterator begin() const; ///< Iterator to first symbol.
+    Iterator end() const; ///< Iterator past the last symbol.
+
+    /// \brief Apply a function to every symbol in order.
+    /// \tparam F Type of function taking a char.
+    /// \param f Function to apply to each symbol in order.
+
+    template<class F> void ForEach(F f) const{
+      if(!m_vNode.empty())
+        ForEach(GetRoot(), f);
+    } //ForEach
+}; //LCompressed
+
+#pragma endregion LCompressed
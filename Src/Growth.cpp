@@ -0,0 +1,534 @@
+/// \file Growth.cpp
+/// \brief Code for the growth predictor LGrowth.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "Growth.h"
+#include "Lsystem.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helper functions
+
+#pragma region Helper functions
+
+/// Add two counts, saturating instead of overflowing.
+/// \param a A count.
+/// \param b Another count.
+/// \return The sum of a and b, or ULLONG_MAX if that would overflow.
+
+static inline ULONGLONG SatAdd(ULONGLONG a, ULONGLONG b){
+  return (a > ULLONG_MAX - b)? ULLONG_MAX: a + b;
+} //SatAdd
+
+/// Multiply two counts, saturating instead of overflowing.
+/// \param a A count.
+/// \param b Another count.
+/// \return The product of a and b, or ULLONG_MAX if that would overflow.
+
+static inline ULONGLONG SatMul(ULONGLONG a, ULONGLONG b){
+  return (a != 0 && b > ULLONG_MAX/a)? ULLONG_MAX: a*b;
+} //SatMul
+
+/// Multiply two square matrices of counts, saturating instead of
+/// overflowing.
+/// \param a A matrix, by rows.
+/// \param b Another matrix of the same size, by rows.
+/// \param m Number of rows and columns.
+/// \param c [out] The product of a and b, which must not be either of them.
+
+static void SatMul(const std::vector<ULONGLONG>& a,
+  const std::vector<ULONGLONG>& b, UINT m, std::vector<ULONGLONG>& c)
+{
+  c.assign((size_t)m*m, 0);
+
+  for(UINT i=0; i<m; i++) //for each row of a
+    for(UINT k=0; k<m; k++){ //for each entry in that row
+      const ULONGLONG x = a[(size_t)i*m + k]; //the entry
+      if(x == 0)continue; //contributes nothing
+
+      const ULONGLONG* row = &b[(size_t)k*m]; //row k of b
+      ULONGLONG* dest = &c[(size_t)i*m]; //row i of c
+
+      for(UINT j=0; j<m; j++)
+        dest[j] = SatAdd(dest[j], SatMul(x, row[j]));
+    } //for
+} //SatMul
+
+#pragma endregion Helper functions
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+
+#pragma region Constructor
+
+/// Build the production matrix from the productions of an L-system. Only
+/// the symbols that can appear in some generation are given a row and a
+/// column, that is, those in the root and those reachable from them through
+/// right-hand sides. The probabilities of the productions for each symbol
+/// are treated as LSystem::Choose() treats them: if they add up to more
+/// than 1 they are scaled down, and if they add up to less than 1 the
+/// remainder is the probability of the symbol being copied. If the
+/// L-system is deterministic, then only the first production for each
+/// symbol is ever applied, so only it is used, even if there are others.
+/// \param lsys An L-system.
+/// \param draw The symbols that draw a line segment, by default those that
+/// CMain's turtle draws with.
+
+LGrowth::LGrowth(const LSystem& lsys, const std::string& draw):
+  m_strRoot(lsys.m_strRoot),
+  m_bStochastic(lsys.m_bStochastic),
+  m_bMemoize(lsys.m_bMemoize),
+  m_nBudget(lsys.m_nMemoryBudget)
+{
+  const UINT NONE = UINT_MAX; //no index
+  std::vector<UINT> index(NUM_LSYMBOLS, NONE); //index of each symbol
+
+  //give c an index if it does not have one
+
+  auto Add = [&](const char c){
+    if(index[(unsigned char)c] == NONE){
+      index[(unsigned char)c] = (UINT)m_strSymbol.size();
+      m_strSymbol += c;
+    } //if
+  }; //Add
+
+  for(const char c: m_strRoot)
+    Add(c);
+
+  for(size_t i=0; i<m_strSymbol.size(); i++){ //reachable symbols, growing
+    auto p = lsys.m_mapRules.find(m_strSymbol[i]); //productions
+
+    if(p != lsys.m_mapRules.end())
+      for(const LProduction& rule: p->second)
+        for(const char c: rule.m_strRHS)
+          Add(c);
+  } //for
+
+  const UINT m = GetSize(); //number of symbols
+  m_vMatrix.assign((size_t)m*m, 0);
+  m_vRoot.assign(m, 0);
+  m_vDraw.assign(m, false);
+  m_vConstant.assign(m, true);
+  m_vOutcome.resize(m);
+
+  for(const char c: m_strRoot)
+    m_vRoot[index[(unsigned char)c]]++;
+
+  for(const char c: draw)
+    if(index[(unsigned char)c] != NONE)
+      m_vDraw[index[(unsigned char)c]] = true;
+
+  for(UINT a=0; a<m; a++){ //for each symbol
+    double* row = &m_vMatrix[(size_t)a*m]; //its row
+    auto p = lsys.m_mapRules.find(m_strSymbol[a]); //its productions
+
+    if(p == lsys.m_mapRules.end() || p->second.empty()){ //a constant
+      row[a] = 1;
+      continue;
+    } //if
+
+    m_vConstant[a] = false;
+
+    if(!m_bStochastic){ //the first production is always applied
+      const LProduction& rule = p->second.front(); //shorthand
+
+      for(const char c: rule.m_strRHS)
+        row[index[(unsigned char)c]]++;
+
+      m_vOutcome[a].push_back(rule.m_strRHS);
+      continue;
+    } //if
+
+    double total = 0; //sum of probabilities
+
+    for(const LProduction& rule: p->second)
+      total += max(0.0, (double)rule.m_fProb);
+
+    const double scale = (total > 1)? 1/total: 1; //to make them add up to 1
+
+    for(const LProduction& rule: p->second){ //for each production
+      const double w = max(0.0, (double)rule.m_fProb)*scale; //its probability
+
+      for(const char c: rule.m_strRHS)
+        row[index[(unsigned char)c]] += w;
+
+      m_vOutcome[a].push_back(rule.m_strRHS);
+    } //for
+
+    if(total < 1){ //may be copied
+      row[a] += 1 - total;
+      m_vOutcome[a].push_back(std::string(1, m_strSymbol[a]));
+    } //if
+  } //for
+} //constructor
+
+#pragma endregion Constructor
+
+///////////////////////////////////////////////////////////////////////////////
+// Matrix
+
+#pragma region Matrix
+
+/// Reader function for the number of symbols, which is the number of rows
+/// and columns of the production matrix.
+/// \return Number of symbols that can appear.
+
+UINT LGrowth::GetSize() const{
+  return (UINT)m_strSymbol.size();
+} //GetSize
+
+/// Reader function for the symbols. Symbol \f$i\f$ of the string has row
+/// and column \f$i\f$ of the production matrix.
+/// \return The symbols that can appear, in index order.
+
+const std::string& LGrowth::GetSymbols() const{
+  return m_strSymbol;
+} //GetSymbols
+
+/// Reader function for an entry of the production matrix.
+/// \param i Row, that is, index of a left-hand side.
+/// \param j Column, that is, index of a symbol.
+/// \return Expected number of times that symbol \f$j\f$ appears in the
+/// expansion of symbol \f$i\f$.
+
+double LGrowth::GetEntry(UINT i, UINT j) const{
+  return m_vMatrix[(size_t)i*GetSize() + j];
+} //GetEntry
+
+/// Compute the expected symbol counts of a generation by multiplying the
+/// root's counts by the production matrix once per generation. The lengths
+/// of the generations along the way are optionally recorded too.
+/// \param n The number of generations.
+/// \param v [out] Expected number of times that each symbol appears in
+/// generation \f$n\f$, by index.
+/// \param pLen [out] Pointer to a vector for the expected length of each
+/// generation from 0 to \f$n\f$, or nullptr if they are not wanted.
+
+void LGrowth::GetCounts(UINT n, std::vector<double>& v,
+  std::vector<double>* pLen) const
+{
+  const UINT m = GetSize(); //number of symbols
+  std::vector<double> next(m); //counts of next generation
+  v = m_vRoot;
+
+  if(pLen)pLen->assign(n + 1, 0);
+
+  for(UINT k=0; k<=n; k++){ //for each generation
+    if(pLen) //record its length
+      for(const double x: v)
+        (*pLen)[k] += x;
+
+    if(k == n)break; //no more generations
+
+    std::fill(next.begin(), next.end(), 0.0);
+
+    for(UINT a=0; a<m; a++) //v times the matrix
+      if(v[a] != 0){
+        const double* row = &m_vMatrix[(size_t)a*m]; //row a
+
+        for(UINT b=0; b<m; b++)
+          next[b] += v[a]*row[b];
+      } //if
+
+    v.swap(next);
+  } //for
+} //GetCounts
+
+/// Compute the exact symbol counts of a generation of a deterministic
+/// L-system without generating it. The production matrix \f$M\f$ is made
+/// again in integers from the one production that each symbol has as an
+/// outcome, rather than converted from `m_vMatrix`, and the counts of
+/// generation \f$n\f$ are the root's counts times \f$M^n\f$. The power
+/// is found by repeated squaring, which
+/// takes \f$O(\log n)\f$ matrix products, so this takes
+/// \f$O(m^3 \log n)\f$ time for \f$m\f$ symbols however large \f$n\f$
+/// is. Counts that do not fit in 64 bits saturate at `ULLONG_MAX`.
+/// \param n The number of generations.
+/// \param v [out] Number of times that each symbol appears in generation
+/// \f$n\f$, by index (see GetSymbols()).
+/// \return true if the counts are exact, false if the L-system is
+/// stochastic, in which case v is left empty. GetCounts() gives expected
+/// counts for stochastic L-systems.
+
+bool LGrowth::GetExactCounts(UINT n, std::vector<ULONGLONG>& v) const{
+  v.clear();
+  if(m_bStochastic)return false; //counts are random
+
+  const UINT m = GetSize(); //number of symbols
+  std::vector<ULONGLONG> power((size_t)m*m, 0); //M to a power of 2
+  std::vector<ULONGLONG> result((size_t)m*m, 0); //M to the bits of n so far
+  std::vector<ULONGLONG> temp; //for products
+
+  std::vector<UINT> index(NUM_LSYMBOLS, 0); //index of each symbol
+  for(UINT a=0; a<m; a++)
+    index[(unsigned char)m_strSymbol[a]] = a;
+
+  for(UINT a=0; a<m; a++){ //make M
+    ULONGLONG* row = &power[(size_t)a*m]; //row a
+
+    if(m_vConstant[a])row[a] = 1; //copied
+    else for(const char c: m_vOutcome[a][0]) //the only production
+      row[index[(unsigned char)c]]++;
+  } //for
+
+  for(UINT a=0; a<m; a++) //identity
+    result[(size_t)a*m + a] = 1;
+
+  for(UINT k=n; k>0; k>>=1){ //for each bit of n
+    if(k & 1){ //multiply it in
+      SatMul(result, power, m, temp);
+      result.swap(temp);
+    } //if
+
+    if(k > 1){ //square
+      SatMul(power, power, m, temp);
+      power.swap(temp);
+    } //if
+  } //for
+
+  v.assign(m, 0);
+
+  for(const char c: m_strRoot){ //add a row of the result for each root symbol
+    const ULONGLONG* row = &result[(size_t)index[(unsigned char)c]*m];
+
+    for(UINT b=0; b<m; b++)
+      v[b] = SatAdd(v[b], row[b]);
+  } //for
+
+  return true;
+} //GetExactCounts
+
+/// Count the line segments that the turtle draws for a generation of a
+/// deterministic L-system exactly, without generating it (see
+/// GetExactCounts()). This can be used to size buffers for the turtle, or
+/// to show progress.
+/// \param n The number of generations.
+/// \param count [out] Number of segments drawn for generation \f$n\f$,
+/// saturating at `ULLONG_MAX`, if the L-system is deterministic.
+/// \return true if the count is exact, false if the L-system is
+/// stochastic, in which case count is zero. GetSegments() gives the
+/// expected count for stochastic L-systems.
+
+bool LGrowth::GetExactSegments(UINT n, ULONGLONG& count) const{
+  count = 0;
+
+  std::vector<ULONGLONG> v; //symbol counts
+  if(!GetExactCounts(n, v))return false; //counts are random
+
+  for(UINT a=0; a<(UINT)v.size(); a++)
+    if(m_vDraw[a])count = SatAdd(count, v[a]);
+
+  return true;
+} //GetExactSegments
+
+#pragma endregion Matrix
+
+///////////////////////////////////////////////////////////////////////////////
+// Predictions
+
+#pragma region Predictions
+
+/// Predict the length of a generation, which is the sum of its symbol
+/// counts. This is exact for deterministic L-systems, but is a floating
+/// point number so that it does not overflow.
+/// \param n The number of generations.
+/// \return Expected number of symbols in generation \f$n\f$.
+
+double LGrowth::GetLength(UINT n) const{
+  std::vector<double> v; //symbol counts
+  GetCounts(n, v);
+
+  double len = 0; //result
+
+  for(const double x: v)
+    len += x;
+
+  return len;
+} //GetLength
+
+/// Predict the number of line segments that the turtle draws for a
+/// generation, which is the sum of the counts of the drawing symbols.
+/// \param n The number of generations.
+/// \return Expected number of segments drawn for generation \f$n\f$.
+
+double LGrowth::GetSegments(UINT n) const{
+  std::vector<double> v; //symbol counts
+  GetCounts(n, v);
+
+  double count = 0; //result
+
+  for(UINT a=0; a<GetSize(); a++)
+    if(m_vDraw[a])count += v[a];
+
+  return count;
+} //GetSegments
+
+/// Predict the maximum depth of nesting of brackets in a generation, which
+/// is the largest number of frames on the turtle's stack. The depth of a
+/// symbol's expansion cannot be found from counts, so for each symbol and
+/// each number of generations up to \f$n\f$ this finds the net change in
+/// depth over the expansion and the highest depth reached within it,
+/// relative to the start. The highest depth within a string is the maximum
+/// over its symbols of the net change before the symbol plus the highest
+/// depth within its expansion. For a stochastic L-system the maximum is
+/// taken over the possible expansions of each symbol, so the result is an
+/// upper bound, not an expected value, which is what is needed to make sure
+/// that the stack fits.
+/// \param n The number of generations.
+/// \return Maximum bracket depth of generation \f$n\f$.
+
+UINT LGrowth::GetDepth(UINT n) const{
+  const UINT m = GetSize(); //number of symbols
+  std::vector<long long> net(m), high(m); //for expansions after k generations
+  std::vector<long long> net2(m), high2(m); //for k + 1 generations
+
+  std::vector<UINT> index(NUM_LSYMBOLS, 0); //index of each symbol
+
+  for(UINT a=0; a<m; a++)
+    index[(unsigned char)m_strSymbol[a]] = a;
+
+  //net change and highest depth of s, given those of each symbol
+
+  auto Measure = [&](const std::string& s, long long& d, long long& h){
+    d = h = 0;
+
+    for(const char c: s){
+      const UINT b = index[(unsigned char)c]; //index of c
+      h = max(h, d + high[b]);
+      d += net[b];
+    } //for
+  }; //Measure
+
+  for(UINT a=0; a<m; a++){ //zero generations
+    const char c = m_strSymbol[a]; //symbol a
+    net[a] = (c == '[')? 1: (c == ']')? -1: 0;
+    high[a] = (c == '[')? 1: 0;
+  } //for
+
+  for(UINT k=0; k<n; k++){ //one more generation each time
+    for(UINT a=0; a<m; a++)
+      if(m_vConstant[a]){ //expands to itself
+        net2[a] = net[a];
+        high2[a] = high[a];
+      } //if
+
+      else{ //worst of the possible expansions
+        net2[a] = LLONG_MIN;
+        high2[a] = 0;
+
+        for(const std::string& s: m_vOutcome[a]){
+          long long d, h; //net change and highest depth of s
+          Measure(s, d, h);
+          net2[a] = max(net2[a], d);
+          high2[a] = max(high2[a], h);
+        } //for
+      } //else
+
+    net.swap(net2);
+    high.swap(high2);
+  } //for
+
+  long long d, h; //net change and highest depth of generation n
+  Measure(m_strRoot, d, h);
+  return (UINT)min(h, (long long)UINT_MAX);
+} //GetDepth
+
+/// Predict the memory in bytes that LSystem::Generate() will use for a
+/// generation, following the same choices that it makes. A deterministic
+/// L-system that uses its expansion cache needs the final generation plus
+/// the cache, which holds the expansion of each symbol after each number of
+/// generations from 1 to \f$n-1\f$. Otherwise two buffers are needed, and
+/// each holds the longest of alternate generations. A stochastic L-system
+/// is derived straight into one buffer for the final generation. Generations
+/// longer than the L-system's memory budget are spilled to files and do not
+/// count. For deterministic L-systems this is the same as
+/// LSystem::GetPredictedMemory(), and for stochastic ones it is an expected
+/// value where that is an upper bound.
+/// \param n The number of generations.
+/// \return Expected number of bytes used by Generate(n).
+
+double LGrowth::GetMemory(UINT n) const{
+  const UINT m = GetSize(); //number of symbols
+  std::vector<double> v, len; //symbol counts, length of each generation
+  GetCounts(n, v, &len);
+
+  const double budget = (double)m_nBudget; //memory budget
+  double total = 0; //result
+
+  if(m_bStochastic){ //one buffer for the final generation
+    if(len[n] <= budget) //not spilled
+      total = len[n];
+  } //if
+
+  else if(m_bMemoize && len[n] <= budget){ //final plus cache
+    std::vector<double> e(m, 1), e2(m); //expanded lengths after k generations
+    total = len[n];
+
+    for(UINT k=1; k<n; k++){ //for each number of generations in the cache
+      for(UINT a=0; a<m; a++){ //the matrix times e
+        const double* row = &m_vMatrix[(size_t)a*m]; //row a
+        e2[a] = 0;
+
+        for(UINT b=0; b<m; b++)
+          e2[a] += row[b]*e[b];
+      } //for
+
+      e.swap(e2);
+
+      for(UINT a=0; a<m; a++)
+        if(!m_vConstant[a])total += e[a];
+    } //for
+  } //if
+
+  else{ //two generation buffers
+    double buffer[2] = {0, 0}; //longest generation in each buffer
+
+    for(UINT k=0; k<=n; k++)
+      if(len[k] <= budget) //not spilled
+        buffer[k & 1] = max(buffer[k & 1], len[k]);
+
+    total = buffer[0] + buffer[1];
+  } //else
+
+  return total;
+} //GetMemory
+
+/// Find the largest number of generations, up to a limit, whose predicted
+/// memory use is within a budget. This is for deciding whether to accept a
+/// request to generate an L-system, or how far to scale it down, before
+/// any memory is used.
+/// \param budget Memory budget in bytes.
+/// \param n The number of generations requested.
+/// \return The largest \f$k \leq n\f$ such that GetMemory(k) is within
+/// budget, or zero if there is none.
+
+UINT LGrowth::GetAffordable(double budget, UINT n) const{
+  for(UINT k=n; k>0; k--)
+    if(GetMemory(k) <= budget)
+      return k;
+
+  return 0;
+} //GetAffordable
+
+#pragma endregion Predictions
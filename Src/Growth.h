@@ -0,0 +1,100 @@
+/// \file Growth.h
+/// \brief Interface for the growth predictor LGrowth.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#pragma once
+
+#include "Includes.h"
+
+class LSystem;
+
+///////////////////////////////////////////////////////////////////////////////
+// class LGrowth
+
+#pragma region LGrowth
+
+/// \brief Growth and cost predictor.
+///
+/// Predicts how large a generation of an L-system will be, and what it will
+/// cost to generate and draw, without generating it. This is done with the
+/// production matrix, which has a row and a column for each symbol that can
+/// appear, and whose entry in row \f$a\f$ and column \f$b\f$ is the number
+/// of times that \f$b\f$ appears in the right-hand side of the production
+/// for \f$a\f$. If \f$v\f$ is the row vector of symbol counts of a
+/// generation, then \f$vM\f$ is that of the next one. For a stochastic
+/// L-system the entry is the expected number of times, that is, the
+/// counts are weighted by the probabilities of the productions, so the
+/// predictions are expected values. Symbols without a production, and
+/// symbols that are copied because the probabilities of their productions
+/// add up to less than 1, count as themselves.
+///
+/// For a deterministic L-system only the first production for each symbol is
+/// applied, so the entries are integers, and the exact symbol counts of any
+/// generation are found by raising the matrix to the power \f$n\f$ by
+/// repeated squaring, in time that grows only with \f$\log n\f$ (see
+/// GetExactCounts()).
+///
+/// Predictions are made for the length, for the number of line segments
+/// that the turtle draws, for the maximum depth of nesting of brackets,
+/// which is the largest size of the turtle's stack, and for the memory
+/// used by LSystem::Generate(). The latter can be used to turn down or scale
+/// down a request before it is attempted, using GetAffordable().
+///
+/// The predictor is a snapshot of the L-system's rules and settings when it
+/// was made, so it should be made again if they change.
+
+class LGrowth{
+  private:
+    std::string m_strRoot; ///< Root string.
+    std::string m_strSymbol; ///< The symbols that can appear, in index order.
+    std::vector<double> m_vMatrix; ///< Production matrix, by rows.
+    std::vector<double> m_vRoot; ///< Symbol counts of the root.
+    std::vector<bool> m_vDraw; ///< Whether each symbol draws a segment.
+    std::vector<bool> m_vConstant; ///< Whether each symbol has no production.
+    std::vector<std::vector<std::string>> m_vOutcome; ///< Possible expansions of each symbol.
+
+    bool m_bStochastic = false; ///< Whether the L-system is stochastic.
+    bool m_bMemoize = true; ///< Whether the L-system uses its expansion cache.
+    size_t m_nBudget = SIZE_MAX; ///< The L-system's memory budget.
+
+  public:
+    LGrowth(const LSystem& lsys, const std::string& draw="FLR"); ///< Constructor.
+
+    UINT GetSize() const; ///< Get number of symbols.
+    const std::string& GetSymbols() const; ///< Get symbols.
+    double GetEntry(UINT i, UINT j) const; ///< Get matrix entry.
+    void GetCounts(UINT n, std::vector<double>& v,
+      std::vector<double>* pLen=nullptr) const; ///< Expected symbol counts.
+    bool GetExactCounts(UINT n, std::vector<ULONGLONG>& v) const; ///< Exact symbol counts.
+    bool GetExactSegments(UINT n, ULONGLONG& count) const; ///< Exact number of segments.
+
+    double GetLength(UINT n) const; ///< Predicted length.
+    double GetSegments(UINT n) const; ///< Predicted number of segments.
+    UINT GetDepth(UINT n) const; ///< Predicted maximum bracket depth.
+    double GetMemory(UINT n) const; ///< Predicted memory use.
+    UINT GetAffordable(double budget, UINT n) const; ///< Most affordable generations.
+}; //LGrowth
+
+#pragma endregion LGrowth
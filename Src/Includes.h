@@ -45,4 +45,9 @@
 #include <string>
 #include <stack>
 #include <map>
-#include <vector>
\ No newline at end of file
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
\ No newline at end of file
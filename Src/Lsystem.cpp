@@ -25,20 +25,73 @@
 
 #include "Types.h"
 #include <sstream>
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #define LSYS_SSE2 ///< SSE2 is available for scanning constants.
+  #include <emmintrin.h>
+#endif
 
 #include "Lsystem.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// Symbol conversion
+
+#pragma region Symbol conversion
+
+/// Narrow a wide string to 8-bit symbols. L-system symbols must be 8-bit
+/// characters, which it is asserted that they are, so each one is converted
+/// to the byte with the same value. A wider character would otherwise turn
+/// into an unrelated symbol.
+/// \param wstr A wide string of 8-bit characters.
+/// \return The string of 8-bit symbols.
+
+static std::string Narrow(const std::wstring& wstr){
+  std::string s(wstr.size(), 0); //result
+
+  for(size_t i=0; i<wstr.size(); i++){
+    assert((unsigned)wstr[i] <= 0xFF); //an 8-bit symbol
+    s[i] = (char)(unsigned char)wstr[i];
+  } //for
+
+  return s;
+} //Narrow
+
+/// Widen a string of 8-bit symbols for display.
+/// \param s A string of 8-bit symbols.
+/// \return The corresponding wide string.
+
+static std::wstring Widen(const std::string& s){
+  std::wstring wstr(s.size(), 0); //result
+
+  for(size_t i=0; i<s.size(); i++)
+    wstr[i] = (wchar_t)(unsigned char)s[i];
+
+  return wstr;
+} //Widen
+
+#pragma endregion Symbol conversion
+
 ///////////////////////////////////////////////////////////////////////////////
 // LProduction: Rule data structure for Lindenmayer Systems
 
 #pragma region LProduction
 
 /// \param lhs Left hand side of production.
-/// \param rhs Right hand side of production.
+/// \param rhs Right hand side of production, whose characters must all be
+/// 8-bit symbols.
 /// \param fProb Production probability (defaults to 1).
 
 LProduction::LProduction(char lhs, const std::wstring rhs, float fProb):
-  m_chLHS(lhs), m_wstrRHS(rhs), m_fProb(fProb){
+  m_chLHS(lhs), m_strRHS(Narrow(rhs)), m_fProb(fProb){
+} //constructor
+
+/// \param lhs Left hand side of production.
+/// \param rhs Right hand side of production, in 8-bit symbols.
+/// \param fProb Production probability (defaults to 1).
+
+LProduction::LProduction(char lhs, const std::string& rhs, float fProb):
+  m_chLHS(lhs), m_strRHS(rhs), m_fProb(fProb){
 } //constructor
 
 #pragma endregion LProduction
@@ -72,7 +125,7 @@ void LSystem::AddRule(const LProduction& rule){
   //add rule to rule string for display
   
   m_wstrRuleString += rule.m_chLHS;
-  m_wstrRuleString += L" \u2192 " + (std::wstring)rule.m_wstrRHS; //\u2192 is an arrow
+  m_wstrRuleString += L" \u2192 " + Widen(rule.m_strRHS); //\u2192 is an arrow
 
   //a bit of fuss here to get the probability with only 2 digits precision
 
@@ -84,14 +137,17 @@ void LSystem::AddRule(const LProduction& rule){
   } //if
 
   m_wstrRuleString += L"\n"; //end of new rule in rule string
+
+  Compile(); //rebuild the rule table
 } //AddRule
 
-/// Set the root, that is, store it in `m_wstrRoot` and prepend it to the rule
+/// Set the root, that is, store it in `m_strRoot` and prepend it to the rule
 /// string `m_wstrRuleString` for display. 
-/// \param omega The new root.
+/// \param omega The new root, whose characters must all be 8-bit symbols.
 
 void LSystem::SetRoot(const std::wstring& omega){
-  m_wstrRoot = omega; //set the root
+  Invalidate(); //old generations are no longer valid
+  m_strRoot = Narrow(omega); //set the root
   m_wstrRuleString = L"Root is " + omega + L"\n" + m_wstrRuleString; //prepend
 } //SetRoot
 
@@ -101,12 +157,227 @@ void LSystem::SetRoot(const std::wstring& omega){
 void LSystem::Clear(){
   m_mapRules.clear(); //no rules
   m_wstrRuleString.clear(); //no rule string
-  m_wstrRoot.clear(); //no root string
-  m_wstrBuffer[0].clear(); //nothing in buffer 0
-  m_wstrBuffer[1].clear(); //nothing in buffer 1
+  m_strRoot.clear(); //no root string
+  m_strBuffer[0].clear(); //nothing in buffer 0
+  m_strBuffer[1].clear(); //nothing in buffer 1
   m_bStochastic = false; //no stochastic rules
+  m_bDeferred = false; //nothing to stream
+
+  Compile(); //empty rule table
 } //Clear
 
+/// Compile the productions in `m_mapRules` into the dense rule table
+/// `m_cRuleTable`. The productions for each left-hand side are stored
+/// consecutively in `m_vCompiled`, in the order in which they were added,
+/// and their right-hand sides are concatenated into `m_strArena`. The
+/// symbols that have productions are recorded in the bitmask `m_uRewritten`
+/// and listed in `m_vRewritten` for ConstantRun(). This is
+/// called whenever the rules change, so there is no need to call it
+/// explicitly before Generate().
+
+void LSystem::Compile(){
+  Invalidate(); //old generations are no longer valid
+
+  for(LRuleRange& r: m_cRuleTable) //clear the rule table
+    r = LRuleRange();
+
+  m_vCompiled.clear(); //no compiled productions
+  m_vAlias.clear(); //no alias tables
+  m_strArena.clear(); //no right-hand sides
+  m_vRewritten.clear(); //no rewritten symbols
+
+  for(UINT& u: m_uRewritten) //every symbol is a constant
+    u = 0;
+
+  for(const auto& p: m_mapRules){ //for each left-hand side
+    LRuleRange& r = m_cRuleTable[(unsigned char)p.first]; //table entry
+    r.m_nFirst = (UINT)m_vCompiled.size();
+    r.m_nCount = (UINT)p.second.size();
+
+    const UINT a = (unsigned char)p.first; //left-hand side
+    m_uRewritten[a >> 5] |= 1U << (a & 31); //a is rewritten
+    m_vRewritten.push_back((char)a);
+
+    for(const LProduction& rule: p.second){ //for each production
+      LCompiledRule c; //compiled production
+      c.m_nOffset = m_strArena.size();
+      c.m_nLength = rule.m_strRHS.size();
+      c.m_fProb = rule.m_fProb;
+
+      m_vCompiled.push_back(c);
+      m_strArena += rule.m_strRHS; //append right-hand side to arena
+    } //for
+
+    CompileAlias(r);
+  } //for
+} //Compile
+
+/// Build the Walker alias table for the productions in a rule table entry
+/// and append it to `m_vAlias`. Bad probabilities are dealt with here, once.
+/// Negative probabilities count as zero. If the probabilities sum to more
+/// than 1, then they are scaled down to sum to 1. If they sum to less than
+/// 1, then the remainder is the probability that the symbol is copied
+/// unchanged, which is an extra outcome in the table.
+///
+/// The table has one entry per outcome, and is built with Vose's method:
+/// outcomes whose probability times the number of entries is below 1 are
+/// topped up from outcomes above 1, which become their aliases.
+/// \param r [in, out] Rule table entry, whose alias range is set.
+
+void LSystem::CompileAlias(LRuleRange& r){
+  std::vector<double> w(r.m_nCount); //probability of each production
+  double total = 0; //sum of probabilities
+
+  for(UINT k=0; k<r.m_nCount; k++){
+    w[k] = max(0.0, (double)m_vCompiled[r.m_nFirst + k].m_fProb);
+    total += w[k];
+  } //for
+
+  if(total > 1) //scale down
+    for(double& x: w)
+      x /= total;
+
+  else if(total < 1) //remainder means copy the symbol
+    w.push_back(1 - total);
+
+  const UINT m = (UINT)w.size(); //number of outcomes
+  r.m_nAlias = (UINT)m_vAlias.size();
+  r.m_nSlots = m;
+
+  std::vector<UINT> low, high; //outcomes below and at least average
+
+  for(UINT k=0; k<m; k++){
+    w[k] *= m; //scale so that the average is 1
+    if(w[k] < 1)low.push_back(k);
+    else high.push_back(k);
+  } //for
+
+  std::vector<LAliasEntry> table(m); //the alias table
+
+  while(!low.empty() && !high.empty()){ //top up a low outcome from a high one
+    const UINT j = low.back(); low.pop_back();
+    const UINT k = high.back();
+
+    table[j].m_nThreshold = (UINT)(w[j]*4294967296.0);
+    table[j].m_nAlias = k;
+
+    w[k] -= 1 - w[j]; //what k gave to j
+
+    if(w[k] < 1){ //k is now low
+      high.pop_back();
+      low.push_back(k);
+    } //if
+  } //while
+
+  for(const UINT k: high){ //always their own outcome
+    table[k].m_nThreshold = UINT_MAX;
+    table[k].m_nAlias = k;
+  } //for
+
+  for(const UINT k: low){ //left over by rounding error, also full
+    table[k].m_nThreshold = UINT_MAX;
+    table[k].m_nAlias = k;
+  } //for
+
+  m_vAlias.insert(m_vAlias.end(), table.begin(), table.end());
+} //CompileAlias
+
+/// Set the number of threads that Generate() may use. Generations that are
+/// shorter than `LSYS_PARALLEL_MIN` symbols are always rewritten on the
+/// calling thread, since starting threads would cost more than it saves.
+/// Deterministic L-systems are generated from the expansion cache unless
+/// that has been turned off with SetMemoize(). The cache itself is filled
+/// on the calling thread, but the last generation, which is most of the
+/// work, is assembled from it on all of the threads. Stochastic L-systems
+/// are derived from the root with the derivation split among the threads
+/// (see GenerateDerived()).
+/// \param n Number of threads. Zero is treated as 1.
+
+void LSystem::SetThreads(UINT n){
+  m_nThreads = (n > 0)? n: 1;
+} //SetThreads
+
+/// Seed the PRNG, so that a stochastic L-system generates the same strings
+/// every time it is given the same seed. The current result is discarded so
+/// that the next call to Generate() starts from the root.
+/// \param seed The seed. A negative seed means seed from the timer.
+
+void LSystem::SetSeed(int seed){
+  m_cRandom.srand(seed);
+  Invalidate();
+} //SetSeed
+
+/// Set the result string to one that was generated earlier, for example,
+/// one kept in a cache, instead of calling Generate(). The caller must make
+/// sure that it really is generation n of the current root and rules.
+/// \param s Generation n.
+/// \param n The number of generations.
+
+void LSystem::SetResult(const std::string& s, const UINT n){
+  Unspill();
+  m_pResult = m_strBuffer; //use the first buffer
+  *m_pResult = s;
+
+  m_nGenerations = m_nCurrent = n;
+  m_bCurrent = true;
+  m_bDeferred = false;
+  m_bCompressed = false;
+} //SetResult
+
+/// Set the result string to one that was generated elsewhere, taking it
+/// over instead of copying it. The caller must make sure that it really is
+/// generation n of the current root and rules.
+/// \param s Generation n, which is left empty.
+/// \param n The number of generations.
+
+void LSystem::SetResult(std::string&& s, const UINT n){
+  Unspill();
+  m_pResult = m_strBuffer; //use the first buffer
+  m_pResult->swap(s);
+  s.clear();
+
+  m_nGenerations = m_nCurrent = n;
+  m_bCurrent = true;
+  m_bDeferred = false;
+  m_bCompressed = false;
+} //SetResult
+
+/// Set the amount of memory that may be used for checkpoints, which are
+/// copies of generations kept so that Generate() can go back to an earlier
+/// generation without starting from the root. The default budget is zero,
+/// that is, no checkpoints. Reducing the budget discards existing checkpoints.
+/// \param n Budget in bytes.
+
+void LSystem::SetCheckpointBudget(size_t n){
+  m_nCheckpointBudget = n;
+
+  if(m_nCheckpointBytes > n){ //over the new budget
+    m_mapCheckpoints.clear();
+    m_nCheckpointBytes = 0;
+  } //if
+} //SetCheckpointBudget
+
+/// Set the length of the longest generation that Generate() keeps in
+/// memory. Generations that are predicted to be longer are spilled to a
+/// file instead (see CSpillFile), and so are all generations after the
+/// first one that is spilled. A spilled result can only be read with
+/// Stream(). The default budget is unlimited, that is, nothing is spilled.
+/// For stochastic L-systems the prediction is an upper bound, so a
+/// generation may be spilled even though it would have fit.
+/// \param n Budget in symbols, which is the same as bytes.
+
+void LSystem::SetMemoryBudget(size_t n){
+  m_nMemoryBudget = n;
+} //SetMemoryBudget
+
+/// Turn the expansion cache used by GenerateMemo() on or off. It is on by
+/// default, and has no effect on stochastic L-systems.
+/// \param b true to use the expansion cache for deterministic L-systems.
+
+void LSystem::SetMemoize(bool b){
+  m_bMemoize = b;
+} //SetMemoize
+
 #pragma endregion Settings functions
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -114,57 +385,1175 @@ void LSystem::Clear(){
 
 #pragma region Generate
 
-/// Generate a string from the root by applying the L-system productions in
+/// Find the length of the run of constants at the start of a string, that
+/// is, symbols that have no production and are copied unchanged. The first few
+/// symbols are checked one at a time against the bitmask `m_uRewritten`,
+/// since runs are usually short. If they are all constants and SSE2 is
+/// available, then the rest of the string is scanned 16 symbols at a time by
+/// comparing them to each of the symbols in `m_vRewritten`, provided there
+/// are not too many of those.
+/// \param p Pointer to a string.
+/// \param n Length of the string.
+/// \return Number of constants before the first rewritten symbol.
+
+size_t LSystem::ConstantRun(const char* p, size_t n) const{
+  const size_t SCALAR = 8; //number of symbols to check one at a time
+  size_t i = 0; //index into p
+
+  for(; i<n && i<SCALAR; i++) //check the first few symbols
+    if(IsRewritten(p[i]))return i;
+
+#ifdef LSYS_SSE2
+  const size_t k = m_vRewritten.size(); //number of rewritten symbols
+
+  if(k <= LSYS_SIMD_SYMBOLS){ //scan 16 at a time
+    __m128i key[LSYS_SIMD_SYMBOLS]; //rewritten symbols in every lane
+
+    for(size_t j=0; j<k; j++)
+      key[j] = _mm_set1_epi8(m_vRewritten[j]);
+
+    for(; i + 16 <= n; i += 16){ //for each block of 16 symbols
+      const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+      __m128i eq = _mm_setzero_si128(); //lanes that match
+
+      for(size_t j=0; j<k; j++)
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, key[j]));
+
+      const UINT mask = (UINT)_mm_movemask_epi8(eq); //1 bit per symbol
+
+      if(mask != 0){ //found a rewritten symbol
+        UINT bit = 0; //index of lowest set bit
+        while(((mask >> bit) & 1) == 0)bit++;
+        return i + bit;
+      } //if
+    } //for
+  } //if
+#endif
+
+  for(; i<n; i++) //the rest one at a time
+    if(IsRewritten(p[i]))return i;
+
+  return n;
+} //ConstantRun
+
+/// Choose the production to apply to a symbol. If the L-system is
+/// stochastic, the high half of the symbol's key is used to choose an
+/// outcome from the symbol's alias table in constant time (see
+/// CompileAlias()). Its high bits, after scaling by the number of table
+/// entries, pick the entry, and the rest is the fraction compared with the
+/// entry's threshold.
+///
+/// The key of a symbol of the root is the CRandom::SubKey() of the seed's
+/// key and the symbol's index in the root, and the key of a symbol of a
+/// later generation is the SubKey() of the key of the symbol that it came
+/// from and its index in that symbol's right-hand side. A symbol that is
+/// copied unchanged is the only symbol of its right-hand side. The choice
+/// is therefore a pure function of the seed and the symbol's derivation
+/// path, and symbols can be expanded in any order, on any thread, any
+/// number of times, with the same result.
+/// \param c A symbol.
+/// \param key The key of this occurrence of c, ignored if the L-system is
+/// deterministic.
+/// \return Pointer to the chosen production, nullptr if none applies.
+
+const LCompiledRule* LSystem::Choose(char c, ULONGLONG key) const{
+  const LRuleRange& r = m_cRuleTable[(unsigned char)c]; //table entry for c
+  if(r.m_nCount == 0)return nullptr; //no production for c
+
+  const LCompiledRule* rule = &m_vCompiled[r.m_nFirst]; //first production
+  if(!m_bStochastic)return rule; //deterministic, so only one production
+
+  const ULONGLONG x = (key >> 32)*r.m_nSlots; //scaled draw
+  const UINT j = (UINT)(x >> 32); //table entry
+  const LAliasEntry& e = m_vAlias[r.m_nAlias + j]; //shorthand
+  const UINT k = ((UINT)x < e.m_nThreshold)? j: e.m_nAlias; //outcome
+
+  return (k < r.m_nCount)? rule + k: nullptr; //the last outcome may be a copy
+} //Choose
+
+/// Apply the productions of a deterministic L-system once to every symbol
+/// of a string, on one thread. Runs of constants are copied in one
+/// operation.
+/// \param src Source string.
+/// \param dest [out] Destination string.
+
+void LSystem::Rewrite(const std::string& src, std::string& dest){
+  dest.clear();
+
+  const char* arena = m_strArena.data(); //right-hand sides
+  const char* p = src.data(); //source symbols
+  const size_t n = src.size(); //number of source symbols
+
+  for(size_t i=0; i<n; i++){ //for each char in source
+    const size_t run = ConstantRun(p + i, n - i); //constants to copy
+
+    if(run > 0){ //copy constants in one go
+      dest.append(p + i, run);
+      i += run;
+      if(i == n)break; //no more symbols
+    } //if
+
+    const LCompiledRule* rule = GetRule(p[i]); //production to apply
+
+    if(rule) //apply production
+      dest.append(arena + rule->m_nOffset, rule->m_nLength);
+    else dest += p[i]; //just copy over the current symbol
+  } //for
+} //Rewrite
+
+/// Run a function on several threads at once and wait for them all to
+/// finish. The calling thread does its share of the work too.
+/// \param n Number of threads.
+/// \param f Function to run, which takes the thread index as its parameter.
+
+static void ParallelFor(UINT n, const std::function<void(UINT)>& f){
+  std::vector<std::thread> threads; //all but the first thread
+
+  for(UINT k=1; k<n; k++)
+    threads.push_back(std::thread(f, k));
+
+  f(0); //do the first share on this thread
+
+  for(std::thread& t: threads)
+    t.join();
+} //ParallelFor
+
+/// Apply the productions of a deterministic L-system once to every symbol
+/// of a string, using `m_nThreads` threads. The source is split into one
+/// chunk per thread. First the length of the expansion of each chunk is
+/// computed in parallel, then a prefix sum of those lengths gives the
+/// offset of each chunk's expansion in the destination, and finally the
+/// chunks are expanded in parallel directly into place.
+/// \param src Source string.
+/// \param dest [out] Destination string.
+
+void LSystem::RewriteParallel(const std::string& src, std::string& dest){
+  const UINT t = m_nThreads; //number of threads
+  const size_t n = src.size(); //number of symbols in source
+  const char* psrc = src.data(); //source symbols
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  std::vector<size_t> start(t + 1); //chunk boundaries in source
+  std::vector<size_t> offset(t + 1, 0); //chunk lengths, then offsets in dest
+
+  for(UINT k=0; k<=t; k++)
+    start[k] = (size_t)((unsigned long long)n*k/t);
+
+  //step 1: measure the expansion of each chunk
+
+  ParallelFor(t, [&](UINT k){
+    const size_t end = start[k + 1]; //end of chunk
+    size_t len = 0; //length of expansion of chunk k
+
+    for(size_t i=start[k]; i<end; i++){ //for each symbol in chunk
+      const size_t run = ConstantRun(psrc + i, end - i); //constants are copied
+      len += run;
+      i += run;
+      if(i == end)break; //no more symbols
+
+      const LCompiledRule* rule = GetRule(psrc[i]);
+      len += rule? rule->m_nLength: 1;
+    } //for
+
+    offset[k + 1] = len;
+  }); //ParallelFor
+
+  //step 2: prefix sum gives each chunk's offset in the destination
+
+  for(UINT k=1; k<=t; k++)
+    offset[k] += offset[k - 1];
+
+  dest.resize(offset[t]); //within capacity if reserved in advance
+  char* pdest = &dest[0]; //destination symbols
+
+  //step 3: expand chunks in parallel into place
+
+  ParallelFor(t, [&](UINT k){
+    char* p = pdest + offset[k]; //where chunk k's expansion goes
+
+    const size_t end = start[k + 1]; //end of chunk
+
+    for(size_t i=start[k]; i<end; i++){ //for each symbol in chunk
+      const size_t run = ConstantRun(psrc + i, end - i); //constants to copy
+
+      if(run > 0){ //copy constants in one go
+        memcpy(p, psrc + i, run);
+        p += run;
+        i += run;
+        if(i == end)break; //no more symbols
+      } //if
+
+      const char c = psrc[i]; //current symbol
+      const LCompiledRule* rule = GetRule(c); //production to apply
+
+      if(rule){ //apply production
+        memcpy(p, arena + rule->m_nOffset, rule->m_nLength);
+        p += rule->m_nLength;
+      } //if
+
+      else *p++ = c; //just copy over the current symbol
+    } //for
+  }); //ParallelFor
+} //RewriteParallel
+
+/// Read the current result a window at a time, whether it is in memory or
+/// spilled to a file. If it is in memory, then it is all one window.
+/// \param src The result string, if the result is not spilled.
+/// \param f Function to call for each window, which takes a pointer to the
+/// symbols, the number of symbols, and the index of the first one.
+
+void LSystem::ReadResult(const std::string& src,
+  const std::function<void(const char*, size_t, size_t)>& f)
+{
+  if(m_pSpill) //read the file
+    m_pSpill->Read([&](const char* p, size_t n, ULONGLONG pos){
+      f(p, n, (size_t)pos);});
+
+  else f(src.data(), src.size(), 0); //all at once
+} //ReadResult
+
+/// Apply the productions of a deterministic L-system once to every symbol of
+/// the current result, whether it is in memory or spilled to a file,
+/// writing the next generation to a file. The source is read a window at a time and the destination is
+/// written sequentially, so neither needs to fit in memory. Runs of
+/// constants are copied in one operation.
+/// \param src The result string, if the result is not spilled.
+/// \param dest [out] Destination file, which must be open and empty.
+
+void LSystem::RewriteSpill(const std::string& src, CSpillFile& dest){
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  ReadResult(src, [&](const char* p, size_t n, size_t){
+    for(size_t i=0; i<n; i++){ //for each char in window
+      const size_t run = ConstantRun(p + i, n - i); //constants to copy
+
+      if(run > 0){ //copy constants in one go
+        dest.Write(p + i, run);
+        i += run;
+        if(i == n)break; //no more symbols
+      } //if
+
+      const LCompiledRule* rule = GetRule(p[i]); //production to apply
+
+      if(rule) //apply production
+        dest.Write(arena + rule->m_nOffset, rule->m_nLength);
+      else dest.Write(p + i, 1); //just copy over the current symbol
+    } //for
+  }); //ReadResult
+
+  dest.Flush();
+} //RewriteSpill
+
+/// Rewrite the current result into the spill file that does not hold it,
+/// which then holds the new result. The generation buffers are freed, since
+/// neither is needed while the result is spilled.
+/// \param src The result string, if the result is not spilled.
+/// \return true if it worked, false if the file could not be written.
+
+bool LSystem::Spill(const std::string& src){
+  CSpillFile& dest = (m_pSpill == m_cSpill)? m_cSpill[1]: m_cSpill[0]; //the other file
+
+  if(!dest.Open())return false; //cannot create file
+  RewriteSpill(src, dest);
+  if(dest.IsFailed())return false; //out of disk space, probably
+
+  if(m_pSpill)m_pSpill->Close(); //the old result
+  m_pSpill = &dest;
+
+  std::string().swap(m_strBuffer[0]); //free memory
+  std::string().swap(m_strBuffer[1]);
+
+  return true;
+} //Spill
+
+/// Close the spill files, which deletes them, so that the result is back in
+/// memory.
+
+void LSystem::Unspill(){
+  m_cSpill[0].Close();
+  m_cSpill[1].Close();
+  m_pSpill = nullptr;
+} //Unspill
+
+/// Add two lengths, saturating instead of overflowing.
+/// \param a A length.
+/// \param b Another length.
+/// \return The sum of a and b, or SIZE_MAX if that would overflow.
+
+static inline size_t SatAdd(size_t a, size_t b){
+  return (a > SIZE_MAX - b)? SIZE_MAX: a + b;
+} //SatAdd
+
+/// Find the symbols that can appear in some generation, that is, the symbols
+/// of the root and those reachable from them through right-hand sides.
+/// \param v [out] Vector of `NUM_LSYMBOLS` flags, indexed by symbol.
+
+void LSystem::GetReachable(std::vector<bool>& v) const{
+  v.assign(NUM_LSYMBOLS, false);
+  std::vector<UINT> stack; //symbols whose right-hand sides are unexplored
+
+  for(const char c: m_strRoot) 
+    if(!v[(unsigned char)c]){
+      v[(unsigned char)c] = true;
+      stack.push_back((unsigned char)c);
+    } //if
+
+  while(!stack.empty()){
+    const LRuleRange& r = m_cRuleTable[stack.back()]; //table entry
+    stack.pop_back();
+
+    for(UINT j=r.m_nFirst; j<r.m_nFirst + r.m_nCount; j++){ //for each rule
+      const LCompiledRule& rule = m_vCompiled[j];
+      const char* rhs = m_strArena.data() + rule.m_nOffset;
+
+      for(size_t i=0; i<rule.m_nLength; i++) //for each symbol in rhs
+        if(!v[(unsigned char)rhs[i]]){
+          v[(unsigned char)rhs[i]] = true;
+          stack.push_back((unsigned char)rhs[i]);
+        } //if
+    } //for
+  } //while
+} //GetReachable
+
+/// Generate a deterministic L-system using a cache of expansions, starting
+/// from either the root or a later generation. The
+/// expansion of symbol \f$a\f$ after \f$k\f$ generations is the
+/// concatenation of the expansions after \f$k-1\f$ generations of the
+/// symbols in its right-hand side. Every reachable symbol is expanded
+/// once for each \f$k < n\f$, from the bottom up, and then the result is
+/// assembled by copying the expansions of the right-hand sides of the
+/// source's symbols. Instead of rewriting every symbol of every
+/// generation, this copies large blocks that are built only once. The cache
+/// holds no more symbols than generation \f$n-1\f$ of the reachable symbols,
+/// and is freed at the end.
+///
+/// The cache is filled on the calling thread. If more than one thread has
+/// been requested with SetThreads(), then the result is assembled from it
+/// in parallel by AssembleParallel().
+///
+/// This is only used for deterministic L-systems. A stochastic production
+/// is chosen by the key of each occurrence of a symbol, and no two
+/// occurrences have the same key, so no two expansions could share an
+/// entry (see Choose()). The hits, misses, and bytes
+/// copied from the cache are recorded in `m_cMemoStats`.
+/// \param src Source string, which must not be the destination.
+/// \param n The number of generations to apply to the source.
+/// \param dest [out] Destination string.
+
+void LSystem::GenerateMemo(const std::string& src, const UINT n,
+  std::string& dest)
+{
+  m_cMemoStats = LMemoStats(); //reset statistics
+
+  std::vector<bool> reachable; //symbols that can appear
+  GetReachable(reachable);
+
+  std::vector<size_t> table; //expanded lengths
+  GetLengthTable(n, table);
+
+  std::vector<std::string> memo; //expansion of a after k generations
+  if(n > 1)memo.resize((size_t)(n - 1)*NUM_LSYMBOLS); //at (k-1)*NUM_LSYMBOLS + a
+
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  //append the expansion of c after k generations, where 0 < k < n
+
+  auto Append = [&](std::string& s, const char c, const UINT k){
+    if(k == 0 || m_cRuleTable[(unsigned char)c].m_nCount == 0)
+      s += c; //a constant, or not expanded
+
+    else{ //expanded
+      const std::string& e = memo[(k - 1)*NUM_LSYMBOLS + (unsigned char)c]; //cached expansion
+      s.append(e);
+      m_cMemoStats.m_nHits++;
+      m_cMemoStats.m_nBytesSaved += e.size();
+    } //else
+  }; //Append
+
+  //append the expansion of c after k generations by expanding its rhs
+
+  auto Expand = [&](std::string& s, const char c, const UINT k){
+    if(m_cRuleTable[(unsigned char)c].m_nCount == 0)
+      s += c; //a constant
+
+    else{ //expand rhs
+      const LCompiledRule& rule = m_vCompiled[m_cRuleTable[(unsigned char)c].m_nFirst];
+      const char* rhs = arena + rule.m_nOffset; //right-hand side
+
+      for(size_t i=0; i<rule.m_nLength; i++)
+        Append(s, rhs[i], k - 1);
+    } //else
+  }; //Expand
+
+  //fill the cache from the bottom up
+
+  for(UINT k=1; k<n; k++) //for each number of generations
+    for(UINT a=0; a<NUM_LSYMBOLS; a++) //for each reachable non-constant
+      if(reachable[a] && m_cRuleTable[a].m_nCount > 0){
+        std::string& e = memo[(k - 1)*NUM_LSYMBOLS + a]; //cache entry
+        e.reserve(table[k*NUM_LSYMBOLS + a]);
+        Expand(e, (char)a, k);
+        m_cMemoStats.m_nMisses++;
+      } //if
+
+  //assemble the result
+
+  const size_t* len = &table[n*NUM_LSYMBOLS]; //expanded lengths
+  size_t total = 0; //length of result
+
+  for(const char c: src) 
+    total = SatAdd(total, len[(unsigned char)c]);
+
+  dest.clear();
+
+  if(n == 0)dest = src; //nothing to expand
+
+  else if(m_nThreads > 1 && total >= LSYS_PARALLEL_MIN && total < SIZE_MAX)
+    AssembleParallel(src, n, memo, table, dest);
+
+  else{ //on this thread
+    dest.reserve(total);
+
+    for(const char c: src) //for each symbol of the source
+      Expand(dest, c, n);
+  } //else
+} //GenerateMemo
+
+/// Assemble generation \f$n\f$ from the expansion cache of GenerateMemo(),
+/// using `m_nThreads` threads. This is the last and by far the largest part
+/// of GenerateMemo(), since the cache holds no more than generation
+/// \f$n-1\f$. The source is split into one chunk per thread. The expanded
+/// lengths give the length of each chunk's expansion, a prefix sum of which
+/// gives where it goes in the destination, and then the chunks are expanded
+/// in parallel directly into place. The cache is only read here, so it can
+/// be shared by the threads. The hits and bytes copied are added to
+/// `m_cMemoStats`.
+/// \param src Source string.
+/// \param n The number of generations to apply to the source, at least 1.
+/// \param memo The expansion cache, as filled by GenerateMemo().
+/// \param table The expanded lengths from GetLengthTable().
+/// \param dest [out] Destination string.
+
+void LSystem::AssembleParallel(const std::string& src, const UINT n,
+  const std::vector<std::string>& memo, const std::vector<size_t>& table,
+  std::string& dest)
+{
+  const UINT t = m_nThreads; //number of threads
+  const size_t m = src.size(); //number of symbols in source
+  const size_t* len = &table[n*NUM_LSYMBOLS]; //expanded lengths
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  std::vector<size_t> start(t + 1); //chunk boundaries in source
+  std::vector<size_t> offset(t + 1, 0); //chunk lengths, then offsets in dest
+  std::vector<LMemoStats> stats(t); //statistics for each thread
+
+  for(UINT k=0; k<=t; k++)
+    start[k] = (size_t)((unsigned long long)m*k/t);
+
+  //step 1: measure the expansion of each chunk
+
+  ParallelFor(t, [&](UINT k){
+    size_t total = 0; //length of expansion of chunk k
+
+    for(size_t i=start[k]; i<start[k + 1]; i++)
+      total += len[(unsigned char)src[i]];
+
+    offset[k + 1] = total;
+  }); //ParallelFor
+
+  //step 2: prefix sum gives each chunk's offset in the destination
+
+  for(UINT k=1; k<=t; k++)
+    offset[k] += offset[k - 1];
+
+  dest.resize(offset[t]);
+  char* pdest = &dest[0]; //destination symbols
+
+  //step 3: expand chunks in parallel into place
+
+  ParallelFor(t, [&](UINT k){
+    char* p = pdest + offset[k]; //where chunk k's expansion goes
+
+    for(size_t i=start[k]; i<start[k + 1]; i++){ //for each symbol in chunk
+      const char c = src[i]; //current symbol
+      const LRuleRange& r = m_cRuleTable[(unsigned char)c]; //table entry for c
+
+      if(r.m_nCount == 0){ //a constant
+        *p++ = c;
+        continue;
+      } //if
+
+      const LCompiledRule& rule = m_vCompiled[r.m_nFirst];
+      const char* rhs = arena + rule.m_nOffset; //right-hand side
+
+      for(size_t j=0; j<rule.m_nLength; j++){ //append expansion of rhs[j]
+        const UINT a = (unsigned char)rhs[j]; //index of rhs[j]
+
+        if(n == 1 || m_cRuleTable[a].m_nCount == 0)
+          *p++ = rhs[j]; //a constant, or not expanded
+
+        else{ //copy from the cache
+          const std::string& e = memo[(n - 2)*NUM_LSYMBOLS + a]; //cached expansion
+          memcpy(p, e.data(), e.size());
+          p += e.size();
+          stats[k].m_nHits++;
+          stats[k].m_nBytesSaved += e.size();
+        } //else
+      } //for
+    } //for
+  }); //ParallelFor
+
+  for(const LMemoStats& s: stats){ //combine statistics
+    m_cMemoStats.m_nHits += s.m_nHits;
+    m_cMemoStats.m_nBytesSaved += s.m_nBytesSaved;
+  } //for
+} //AssembleParallel
+
+/// Make a derivation frame for the root. Its key is the key of the PRNG's
+/// stream 0 for the seed, so the keys of the root's symbols are the keys
+/// of that stream's children.
+/// \return A frame holding all of the root.
+
+LDeriveFrame LSystem::GetRootFrame() const{
+  LDeriveFrame f; //result
+  f.m_pBegin = f.m_pNext = m_strRoot.data();
+  f.m_pEnd = f.m_pBegin + m_strRoot.size();
+  f.m_nKey = m_cRandom.GetKey();
+
+  return f;
+} //GetRootFrame
+
+/// Apply the productions to the remaining characters of a frame a number of
+/// times, by a depth-first derivation using an explicit stack with one
+/// frame per generation, and pass the result to a function a piece at a
+/// time. Runs of constants, and the right-hand sides chosen for the symbols
+/// of the last generation but one, are passed in one piece. The key of each
+/// symbol that is expanded is made from the key of its frame (see
+/// Choose()), so the result is the same as rewriting one generation at a
+/// time.
+/// \tparam F Type of function taking a pointer to characters and a count.
+/// \param f A derivation frame.
+/// \param k The number of generations.
+/// \param stack Stack to use, so that it can be reused.
+/// \param sink Function to call for each piece of the result, in order.
+
+template<class F> void LSystem::Derive(const LDeriveFrame& f, const UINT k,
+  std::vector<LDeriveFrame>& stack, F& sink) const
+{
+  if(k == 0){ //nothing to expand
+    sink(f.m_pNext, f.m_pEnd - f.m_pNext);
+    return;
+  } //if
+
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  stack.clear();
+  stack.reserve(k);
+  stack.push_back(f);
+
+  while(!stack.empty()){
+    LDeriveFrame& top = stack.back(); //top of stack
+
+    if(top.m_pNext == top.m_pEnd){ //string used up
+      stack.pop_back();
+      continue;
+    } //if
+
+    const size_t run = ConstantRun(top.m_pNext, top.m_pEnd - top.m_pNext); //constants
+
+    if(run > 0){ //pass constants in one go
+      sink(top.m_pNext, run);
+      top.m_pNext += run;
+      continue;
+    } //if
+
+    const char* p = top.m_pNext++; //symbol to expand
+    const ULONGLONG key = m_bStochastic?
+      CRandom::SubKey(top.m_nKey, p - top.m_pBegin): 0; //its key
+    const LCompiledRule* rule = Choose(*p, key); //production to apply
+
+    LDeriveFrame g; //frame for the expansion of *p
+    g.m_pBegin = g.m_pNext = rule? arena + rule->m_nOffset: p;
+    g.m_pEnd = g.m_pNext + (rule? rule->m_nLength: 1);
+    g.m_nKey = key;
+
+    if(stack.size() == k) //in the last generation
+      sink(g.m_pNext, g.m_pEnd - g.m_pNext);
+    else stack.push_back(g); //expand *p
+  } //while
+} //Derive
+
+/// Measure the length of a derivation without making it (see Derive()).
+/// Only the productions for the last generation but one are chosen, and
+/// only their lengths are used, so this costs about as much as deriving
+/// the generation before.
+/// \param f A derivation frame.
+/// \param k The number of generations.
+/// \param stack Stack to use, so that it can be reused.
+/// \return The length of the derivation.
+
+size_t LSystem::Measure(const LDeriveFrame& f, const UINT k,
+  std::vector<LDeriveFrame>& stack) const
+{
+  size_t len = 0; //result
+  auto Add = [&](const char*, size_t n){len += n;};
+  Derive(f, k, stack, Add);
+
+  return len;
+} //Measure
+
+/// Split a derivation of the root into many smaller ones, by expanding the
+/// root one generation at a time, breadth first, until there are at least
+/// `LSYS_FRONTIER_MIN` symbols or all generations are done. Each symbol
+/// of the frontier is returned as a frame that holds only that symbol, so
+/// that it has the right key, and constants are carried from one generation
+/// to the next unchanged. Deriving each frame for the remaining generations
+/// and concatenating the results gives generation \f$n\f$.
+/// \param n The number of generations.
+/// \param v [out] The frontier, one frame per symbol.
+/// \return The number of generations that the frontier is from the root.
+
+UINT LSystem::GetFrontier(const UINT n, std::vector<LDeriveFrame>& v) const{
+  const char* arena = m_strArena.data(); //right-hand sides
+  const LDeriveFrame root = GetRootFrame(); //frame for the root
+
+  v.clear();
+
+  for(const char* p=root.m_pBegin; p<root.m_pEnd; p++){ //one frame per symbol
+    LDeriveFrame f = root;
+    f.m_pNext = p;
+    f.m_pEnd = p + 1;
+    v.push_back(f);
+  } //for
+
+  std::vector<LDeriveFrame> next; //the frontier one generation later
+  UINT d = 0; //generations done
+
+  for(; d<n && v.size()<LSYS_FRONTIER_MIN; d++){ //one more generation
+    next.clear();
+
+    for(const LDeriveFrame& f: v){ //for each symbol of the frontier
+      const char* p = f.m_pNext; //shorthand
+
+      if(!IsRewritten(*p)){ //a constant
+        next.push_back(f);
+        continue;
+      } //if
+
+      const ULONGLONG key = m_bStochastic?
+        CRandom::SubKey(f.m_nKey, p - f.m_pBegin): 0; //its key
+      const LCompiledRule* rule = Choose(*p, key); //production to apply
+
+      LDeriveFrame g; //frame for one symbol of the expansion of *p
+      g.m_pBegin = rule? arena + rule->m_nOffset: p;
+      g.m_nKey = key;
+
+      const size_t len = rule? rule->m_nLength: 1; //length of expansion
+
+      for(size_t j=0; j<len; j++){ //one frame per symbol
+        g.m_pNext = g.m_pBegin + j;
+        g.m_pEnd = g.m_pNext + 1;
+        next.push_back(g);
+      } //for
+    } //for
+
+    v.swap(next);
+  } //for
+
+  return d;
+} //GetFrontier
+
+/// Generate a stochastic L-system by deriving generation \f$n\f$ straight
+/// from the root, without making the generations in between, which could
+/// not be continued from anyway since their symbols' keys are not kept.
+/// The derivation is split into a frontier of small ones (see
+/// GetFrontier()), and the frontier is split into one chunk per thread if
+/// more than one thread has been requested with SetThreads() and the
+/// result may be long enough. As in RewriteParallel(), the length of each
+/// chunk's derivation is measured in parallel, a prefix sum gives where it
+/// goes, and the chunks are derived in parallel directly into place. The
+/// result is the same for any number of threads.
+///
+/// If the result is too long for the memory budget set by
+/// SetMemoryBudget(), then it is derived on this thread into a spill file
+/// instead. If the file cannot be written, then the result is left empty.
+/// \param n The number of generations.
+
+void LSystem::GenerateDerived(const UINT n){
+  if(m_bCurrent && m_nCurrent == n)return; //already generated
+
+  m_pResult = m_strBuffer; //the result goes in the first buffer
+  m_bCurrent = false; //about to be overwritten
+  Unspill();
+  std::string().swap(m_strBuffer[1]); //not needed
+
+  std::vector<LDeriveFrame> frontier; //small derivations
+  const UINT k = n - GetFrontier(n, frontier); //generations left to derive
+  const size_t m = frontier.size(); //number of small derivations
+
+  const UINT t = (m_nThreads > 1 && m >= m_nThreads &&
+    GetPredictedLength(n) >= LSYS_PARALLEL_MIN)? m_nThreads: 1; //number of threads
+
+  std::vector<size_t> start(t + 1); //chunk boundaries in frontier
+  std::vector<size_t> offset(t + 1, 0); //chunk lengths, then offsets in result
+
+  for(UINT j=0; j<=t; j++)
+    start[j] = (size_t)((unsigned long long)m*j/t);
+
+  //step 1: measure the derivation of each chunk
+
+  ParallelFor(t, [&](UINT j){
+    std::vector<LDeriveFrame> stack; //derivation stack for this thread
+
+    for(size_t i=start[j]; i<start[j + 1]; i++)
+      offset[j + 1] += Measure(frontier[i], k, stack);
+  }); //ParallelFor
+
+  //step 2: prefix sum gives each chunk's offset in the result
+
+  for(UINT j=1; j<=t; j++)
+    offset[j] += offset[j - 1];
+
+  std::string& dest = m_strBuffer[0]; //result
+
+  if(offset[t] > m_nMemoryBudget){ //too long for memory, so spill
+    std::string().swap(dest); //free memory
+    CSpillFile& file = m_cSpill[0]; //the spill file
+
+    if(file.Open()){ //derive into the file
+      std::vector<LDeriveFrame> stack; //derivation stack
+      auto Write = [&](const char* p, size_t len){file.Write(p, len);};
+
+      for(const LDeriveFrame& f: frontier)
+        Derive(f, k, stack, Write);
+
+      file.Flush();
+    } //if
+
+    if(!file.IsOpen() || file.IsFailed()){ //give up
+      Unspill();
+      return;
+    } //if
+
+    m_pSpill = &file;
+  } //if
+
+  else{ //step 3: derive chunks in parallel into place
+    dest.resize(offset[t]);
+    char* pdest = &dest[0]; //result symbols
+
+    ParallelFor(t, [&](UINT j){
+      std::vector<LDeriveFrame> stack; //derivation stack for this thread
+      char* q = pdest + offset[j]; //where chunk j's derivation goes
+
+      auto Copy = [&](const char* p, size_t len){
+        memcpy(q, p, len);
+        q += len;
+      }; //Copy
+
+      for(size_t i=start[j]; i<start[j + 1]; i++)
+        Derive(frontier[i], k, stack, Copy);
+    }); //ParallelFor
+  } //else
+
+  m_nCurrent = n;
+  m_bCurrent = true;
+} //GenerateDerived
+
+/// Generate a string by applying the L-system productions in
 /// parallel, and repeating for a fixed number of generations. Double-buffering
-/// is used, that is, if generation \f$i\f$ is stored in m_wstrBuffer[\f$j\f$],
+/// is used, that is, if generation \f$i\f$ is stored in m_strBuffer[\f$j\f$],
 /// where \f$j \in \{0,1\}\f$, then generation \f$i+1\f$ is stored in
-/// m_wstrBuffer[\f$j + 1 \pmod 2\f$]. Zero generations means the root string,
+/// m_strBuffer[\f$j + 1 \pmod 2\f$]. Zero generations means the root string,
 /// 1 generation means 1 pass from left to right applying the rules, etc.
+/// Productions are found in the compiled rule table `m_cRuleTable` and copied
+/// from `m_strArena`, so no strings are copied other than into the
+/// destination buffer.
+///
+/// The buffers are reserved before they are written so that there are no
+/// reallocations while rewriting. The length of every generation is known
+/// in advance and each buffer is reserved once, for the longest generation
+/// that it will hold.
+///
+/// The productions of a stochastic L-system are chosen by the derivation
+/// path of each symbol (see Choose()), which is not kept in the string, so
+/// a stochastic L-system is instead derived from the root by
+/// GenerateDerived(). It gives the same string for the same seed however it
+/// is generated. Only the current result is reused, and no checkpoints are
+/// kept.
+///
+/// If more than one thread has been requested with SetThreads(), then
+/// generations that are long enough are rewritten by RewriteParallel()
+/// instead of Rewrite(). The result is the same either way. Deterministic
+/// L-systems are generated by GenerateMemo() instead, unless that has been
+/// turned off with SetMemoize(), and it uses the threads for the last
+/// generation.
+///
+/// Generation starts from the result of the previous call if that is an
+/// earlier generation, or else from a checkpoint if there is one (see
+/// Resume()). This makes stepping through the generations one at a time
+/// cost one pass per step.
+///
+/// Generations that are too long for the memory budget set by
+/// SetMemoryBudget() are rewritten from one spill file to another by
+/// RewriteSpill() instead, a window at a time. They are never memoized,
+/// rewritten in parallel, or kept as checkpoints. If the result is spilled,
+/// then it can only be read with Stream().
+///
+/// If the last generation is deferred, then only \f$n-1\f$ generations are
+/// generated here, and the last one is left to Stream(). For a stochastic
+/// L-system nothing is generated here, and Stream() derives generation
+/// \f$n\f$ from the root. GetString() must not be used until Generate() is
+/// next called without deferral.
+///
+/// If a spill file cannot be written, for example because the disk is full,
+/// then the result is left empty.
 /// \param n The number of generations.
+/// \param bDefer true to defer the last generation to Stream().
 
-void LSystem::Generate(const UINT n){
+void LSystem::Generate(const UINT n, const bool bDefer){
   m_nGenerations = n;
+  m_bDeferred = bDefer && n > 0;
+  m_bCompressed = false;
+  m_cCompressed.Clear();
+
+  if(m_bStochastic){ //derive from the root
+    if(!m_bDeferred)GenerateDerived(n);
+    return;
+  } //if
+
+  const UINT m = m_bDeferred? n - 1: n; //number of generations to do here
+  const UINT start = Resume(m); //generation in m_pResult to start from
 
-  std::wstring* pSrc = &m_wstrBuffer[0]; //source buffer
-  std::wstring* pDest = &m_wstrBuffer[1]; //destination buffer
+  std::string* pSrc = m_pResult; //source buffer
+  std::string* pDest = (pSrc == m_strBuffer)? pSrc + 1: pSrc - 1; //the other
 
-  *pSrc = m_wstrRoot; //copy root string to source buffer
- 
-  for(UINT i=0; i<n; i++){ //for each generation 
-    pDest->clear();
+  std::vector<size_t> v; //length of each generation
+  PredictLengths(m, v);
+
+  if(m_bMemoize && !m_pSpill && v[m] <= m_nMemoryBudget){ //expand from the cache
+    if(start < m){ //anything to do
+      GenerateMemo(*pSrc, m - start, *pDest);
+      std::swap(pSrc, pDest);
+    } //if
+  } //if
 
-    for(size_t i=0; i<pSrc->size(); i++){ //for each char in source
-      bool bRuleApplied = false; //whether a rule has been applied yet
+  else{ //rewrite one generation at a time
+    size_t len[2] = {0, 0}; //longest generation in each buffer
 
-      auto p = m_mapRules.find((*pSrc)[i]);
+    for(UINT i=start; i<=m; i++)
+      if(v[i] <= m_nMemoryBudget) //not spilled
+        len[(i - start) & 1] = max(len[(i - start) & 1], v[i]);
 
-      if(p != m_mapRules.end()){
-        float fProb = 0; //cumulative probability
-        const float fRand = m_cRandom.randf(); //random value in [0, 1]
+    pSrc->reserve(len[0]);
+    pDest->reserve(len[1]);
 
-        for(auto rule: p->second){ //for each production that applies
-          fProb += rule.m_fProb; //accumulate probability
+    for(UINT i=start; i<m; i++){ //for each generation 
+      if(m_pSpill || v[i + 1] > m_nMemoryBudget){ //too long for memory
+        if(!Spill(*pSrc)){ //give up
+          Unspill();
+          m_pResult = pSrc;
+          m_pResult->clear();
+          m_bCurrent = false;
+          return;
+        } //if
 
-          if(fRand <= fProb){ //use the current rule
-            *pDest += rule.m_wstrRHS; //apply rule
-            bRuleApplied = true; //record that a rule was applied
-            break; //no need to try more rules
-          } //if
-        } //for
+        continue;
       } //if
 
-      if(!bRuleApplied) //no rule was applied to current symbol
-        *pDest += (*pSrc)[i]; //just copy over the current symbol
+      if(m_nThreads > 1 && pSrc->size() >= LSYS_PARALLEL_MIN)
+        RewriteParallel(*pSrc, *pDest);
+      else Rewrite(*pSrc, *pDest);
+
+      std::swap(pSrc, pDest); //swap generation buffers 
+
+      if(i + 1 < m) //keep a checkpoint
+        Checkpoint(i + 1, *pSrc);
     } //for
+  } //else
 
-    std::swap(pSrc, pDest); //swap generation buffers 
-  } //for
+  m_pResult = pSrc; //the latest string, after the swap, is in the source buffer
+  m_nCurrent = m;
+  m_bCurrent = true;
 
-  m_pResult = pDest; //copy the latest string to the result string
+  if(!m_pSpill) //keep a checkpoint
+    Checkpoint(m, *m_pResult);
 } //Generate
 
+/// Generate a deterministic L-system for a given number of generations in
+/// compressed form (see LCompressed), instead of as a string. The result is
+/// read with GetCompressed(), and GetString() must not be used until
+/// Generate() or SetResult() is next called. The generation buffers and
+/// checkpoints are left alone. If the L-system is stochastic, then the
+/// compressed string is empty.
+/// \param n The number of generations.
+
+void LSystem::Compress(const UINT n){
+  m_cCompressed.Build(*this, n);
+  m_nGenerations = n;
+  m_bDeferred = false;
+  m_bCompressed = true;
+} //Compress
+
+/// Decide where Generate() should start from, and put that generation in
+/// `*m_pResult`. If the current result is the same or an earlier
+/// generation of the same rules and seed, then generation continues from
+/// it. Otherwise it starts from the latest checkpoint that is no later than
+/// the target, or from the root if there is none.
+/// \param n The number of generations to be generated.
+/// \return The number of generations in `*m_pResult`.
+
+UINT LSystem::Resume(const UINT n){
+  if(m_bCurrent && m_nCurrent <= n)
+    return m_nCurrent; //continue from the current result
+
+  m_pResult = m_strBuffer; //start in the first buffer
+  m_bCurrent = false; //about to be overwritten
+  Unspill();
+
+  auto p = m_mapCheckpoints.upper_bound(n); //first checkpoint later than n
+
+  if(p != m_mapCheckpoints.begin()){ //there is one no later than n
+    --p;
+    *m_pResult = p->second;
+    return p->first;
+  } //if
+
+  *m_pResult = m_strRoot; //copy root string
+  return 0;
+} //Resume
+
+/// Keep a copy of a generation so that Generate() can later go back to it
+/// without starting from the root. Checkpoints are only kept within the
+/// budget set by SetCheckpointBudget(). When over budget, the checkpoints for
+/// the earliest generations are discarded first, since they are the
+/// cheapest to generate again. The root is never kept, since it is always
+/// available.
+/// \param n The number of generations in s.
+/// \param s Generation n.
+
+void LSystem::Checkpoint(const UINT n, const std::string& s){
+  const size_t bytes = s.size(); //size of new checkpoint
+
+  if(n == 0 || bytes > m_nCheckpointBudget || m_mapCheckpoints.count(n) > 0)
+    return; //not needed or not affordable
+
+  while(m_nCheckpointBytes + bytes > m_nCheckpointBudget){ //make room
+    auto p = m_mapCheckpoints.begin(); //earliest generation
+    m_nCheckpointBytes -= p->second.size();
+    m_mapCheckpoints.erase(p);
+  } //while
+
+  m_mapCheckpoints.insert(std::make_pair(n, s));
+  m_nCheckpointBytes += bytes;
+} //Checkpoint
+
+/// Discard the current result, the compressed result, the spill files, and
+/// all checkpoints. This must be done whenever the root or the rules change.
+
+void LSystem::Invalidate(){
+  m_bCurrent = false;
+  Unspill();
+  m_mapCheckpoints.clear();
+  m_nCheckpointBytes = 0;
+  m_bCompressed = false;
+  m_cCompressed.Clear();
+} //Invalidate
+
+/// Push the generated string onto a ring buffer and close it. If the last
+/// generation was deferred by Generate(), then it is rewritten here from the
+/// previous one, or for a stochastic L-system derived from the root (see
+/// Derive()), a batch at a time, so that the reader can start on it
+/// straight away. A spilled string is read from its file a window at a
+/// time. The productions are chosen as Generate() would have
+/// chosen them, so streaming again gives the same string. Call this on the
+/// producer thread of the ring.
+/// \param ring A ring buffer.
+
+void LSystem::Stream(CRingBuffer<char>& ring){
+  const std::string& src = *m_pResult; //shorthand
+
+  if(!m_bDeferred) //already generated
+    ReadResult(src, [&](const char* p, size_t n, size_t){
+      ring.Push(p, n);});
+
+  else{ //rewrite or derive now
+    const char* arena = m_strArena.data(); //right-hand sides
+
+    const size_t BATCHSIZE = 4096; //number of symbols to push at a time
+    std::vector<char> batch; //symbols waiting to be pushed
+    batch.reserve(BATCHSIZE);
+
+    auto Push = [&](const char* p, size_t len){ //push symbols in batches
+      if(batch.size() + len > BATCHSIZE){ //batch is full
+        ring.Push(batch.data(), batch.size());
+        batch.clear();
+      } //if
+
+      if(len > BATCHSIZE)ring.Push(p, len); //too long to batch
+      else batch.insert(batch.end(), p, p + len);
+    }; //Push
+
+    if(m_bStochastic){ //derive from the root
+      std::vector<LDeriveFrame> stack; //derivation stack
+      Derive(GetRootFrame(), m_nGenerations, stack, Push);
+    } //if
+
+    else ReadResult(src, [&](const char* q, size_t n, size_t){
+      for(size_t i=0; i<n; i++){ //for each char in window
+        const LCompiledRule* rule = GetRule(q[i]); //production to apply
+
+        if(rule)Push(arena + rule->m_nOffset, rule->m_nLength);
+        else Push(q + i, 1);
+      } //for
+    }); //ReadResult
+
+    ring.Push(batch.data(), batch.size()); //the remainder
+  } //else
+
+  ring.Close();
+} //Stream
+
 #pragma endregion Generate
 
+///////////////////////////////////////////////////////////////////////////////
+// Prediction
+
+#pragma region Prediction
+
+/// Compute a table of the expanded length of each symbol, that is, the length
+/// of the string that it generates after \f$k\f$ generations, for
+/// \f$0 \leq k \leq n\f$. Symbols without a production have expanded
+/// length 1, and the expanded length of a symbol after \f$k+1\f$ generations
+/// is the sum of the expanded lengths after \f$k\f$ generations of the
+/// symbols in its right-hand side. A deterministic L-system only ever applies
+/// the first production for each symbol (see Choose()), so only that one is
+/// used and the table is exact. For a stochastic L-system the longest
+/// production is used, so the table is an upper bound. Lengths that do not
+/// fit in a `size_t` are reported as `SIZE_MAX`.
+/// \param n The number of generations.
+/// \param v [out] Table with \f$n+1\f$ rows of `NUM_LSYMBOLS` entries, the
+/// expanded length of symbol \f$a\f$ after \f$k\f$ generations being
+/// in entry `v[k*NUM_LSYMBOLS + a]`.
+
+void LSystem::GetLengthTable(UINT n, std::vector<size_t>& v) const{
+  v.assign((size_t)(n + 1)*NUM_LSYMBOLS, 1);
+
+  const char* arena = m_strArena.data(); //right-hand sides
+
+  for(UINT k=1; k<=n; k++){ //for each generation after the first
+    const size_t* len = &v[(k - 1)*NUM_LSYMBOLS]; //previous row
+    size_t* next = &v[k*NUM_LSYMBOLS]; //this row
+
+    for(UINT a=0; a<NUM_LSYMBOLS; a++){ //for each symbol with productions
+      const LRuleRange& r = m_cRuleTable[a]; //table entry for a
+      if(r.m_nCount == 0)continue; //a is a constant
+
+      next[a] = 0;
+
+      const UINT count = m_bStochastic? r.m_nCount: 1; //productions that apply
+
+      for(UINT j=r.m_nFirst; j<r.m_nFirst + count; j++){ //for each rule
+        const LCompiledRule& rule = m_vCompiled[j];
+        const char* rhs = arena + rule.m_nOffset; //right-hand side
+        size_t sum = 0; //expanded length of rhs
+
+        for(size_t i=0; i<rule.m_nLength; i++)
+          sum = SatAdd(sum, len[(unsigned char)rhs[i]]);
+
+        next[a] = max(next[a], sum);
+      } //for
+    } //for
+  } //for
+} //GetLengthTable
+
+/// Predict the length of each generation up to a given number of generations
+/// without generating any of them, by summing the expanded lengths of the
+/// symbols in the root (see GetLengthTable()).
+/// \param n The number of generations.
+/// \param v [out] Vector of \f$n+1\f$ lengths, indexed by generation.
+
+void LSystem::PredictLengths(UINT n, std::vector<size_t>& v) const{
+  std::vector<size_t> table; //expanded lengths
+  GetLengthTable(n, table);
+
+  v.assign(n + 1, 0);
+
+  for(UINT k=0; k<=n; k++){ //for each generation
+    const size_t* len = &table[k*NUM_LSYMBOLS]; //expanded lengths
+
+    for(const char c: m_strRoot) //length of generation k
+      v[k] = SatAdd(v[k], len[(unsigned char)c]);
+  } //for
+} //PredictLengths
+
+/// Predict the length of a generation without generating it. The prediction
+/// is exact for deterministic L-systems, even those with more than one
+/// production for a symbol, since only the first is applied. For stochastic
+/// ones it is an upper bound, using the longest production for each symbol.
+/// \param n The number of generations.
+/// \return The length of the string that Generate(n) would generate.
+
+size_t LSystem::GetPredictedLength(UINT n) const{
+  std::vector<size_t> v; //length of each generation
+  PredictLengths(n, v);
+  return v[n];
+} //GetPredictedLength
+
+/// Predict the amount of memory in bytes that the generation buffers
+/// `m_strBuffer[2]` will need for Generate(n) without generating anything.
+/// This is exact for deterministic L-systems, which apply only the first
+/// production for each symbol, and for which each buffer is reserved once
+/// for the longest generation that it will hold. If the
+/// expansion cache is used, then only one buffer is needed, but the size of
+/// the cache is included. A stochastic L-system is derived straight into one
+/// buffer (see GenerateDerived()), so this is an upper bound on its length.
+/// Generations longer than the memory budget are spilled to files (see
+/// SetMemoryBudget()), so they are not included.
+/// \param n The number of generations.
+/// \return Number of bytes needed by the generation buffers.
+
+size_t LSystem::GetPredictedMemory(UINT n) const{
+  std::vector<size_t> v; //length of each generation
+  PredictLengths(n, v);
+
+  size_t total = 0; //total number of symbols
+
+  if(m_bStochastic){ //one buffer for the final generation
+    if(v[n] <= m_nMemoryBudget) //not spilled
+      total = v[n];
+  } //if
+
+  else if(m_bMemoize && v[n] <= m_nMemoryBudget){ //final generation plus cache
+    std::vector<bool> reachable; //symbols that can appear
+    GetReachable(reachable);
+
+    std::vector<size_t> table; //expanded lengths
+    GetLengthTable(n, table);
+
+    total = v[n];
+
+    for(UINT k=1; k<n; k++) //for each number of generations in the cache
+      for(UINT a=0; a<NUM_LSYMBOLS; a++) //for each cached symbol
+        if(reachable[a] && m_cRuleTable[a].m_nCount > 0)
+          total = SatAdd(total, table[k*NUM_LSYMBOLS + a]);
+  } //if
+
+  else{ //two generation buffers
+    size_t len[2] = {0, 0}; //longest generation in each buffer
+
+    for(UINT i=0; i<=n; i++)
+      if(v[i] <= m_nMemoryBudget) //not spilled
+        len[i & 1] = max(len[i & 1], v[i]);
+
+    total = SatAdd(len[0], len[1]);
+  } //else
+
+  return total;
+} //GetPredictedMemory
+
+#pragma endregion Prediction
+
 ///////////////////////////////////////////////////////////////////////////////
 // Reader functions
 
@@ -173,10 +1562,24 @@ void LSystem::Generate(const UINT n){
 /// Reader function for the result string `*m_pResult`.
 /// \return A const reference to the result string `*m_pResult`.
 
-const std::wstring& LSystem::GetString() const{
+const std::string& LSystem::GetString() const{
   return *m_pResult;
 } //GetString
 
+/// Reader function for whether the result is spilled to a file.
+/// \return true if the result can only be read with Stream().
+
+const bool LSystem::IsSpilled() const{
+  return m_pSpill != nullptr && !m_bCompressed;
+} //IsSpilled
+
+/// Reader function for the compressed result `m_cCompressed`.
+/// \return A const reference to the compressed result `m_cCompressed`.
+
+const LCompressed& LSystem::GetCompressed() const{
+  return m_cCompressed;
+} //GetCompressed
+
 /// Reader function for the rule string `m_wstrRuleString`.
 /// \return A const reference to the rule string `m_wstrRuleString`.
 
@@ -198,4 +1601,209 @@ const bool LSystem::IsStochastic() const{
   return m_bStochastic;
 } //IsStochastic
 
+/// Reader function for the deferral flag `m_bDeferred`.
+/// \return true if the last generation is to be streamed by Stream().
+
+const bool LSystem::IsDeferred() const{
+  return m_bDeferred;
+} //IsDeferred
+
+/// Reader function for the compression flag `m_bCompressed`.
+/// \return true if the result was generated by Compress().
+
+const bool LSystem::IsCompressed() const{
+  return m_bCompressed;
+} //IsCompressed
+
+/// Reader function for the expansion cache statistics `m_cMemoStats`.
+/// \return A const reference to the statistics from the last time that
+/// GenerateMemo() was used.
+
+const LMemoStats& LSystem::GetMemoStats() const{
+  return m_cMemoStats;
+} //GetMemoStats
+
+/// Compute a hash of the root and the productions, which identifies the
+/// strings that this L-system generates from a given seed.
+/// \return A 64-bit hash.
+
+ULONGLONG LSystem::GetHash() const{
+  ULONGLONG h = HashBytes(m_strRoot.data(), m_strRoot.size());
+
+  for(const auto& p: m_mapRules) //for each left-hand side
+    for(const LProduction& rule: p.second){ //for each production
+      h = HashBytes(&rule.m_chLHS, sizeof(rule.m_chLHS), h);
+      h = HashBytes(&rule.m_fProb, sizeof(rule.m_fProb), h);
+
+      const size_t n = rule.m_strRHS.size(); //length of right-hand side
+      h = HashBytes(&n, sizeof(n), h); //separates right-hand sides
+      h = HashBytes(rule.m_strRHS.data(), n, h);
+    } //for
+
+  return h;
+} //GetHash
+
 #pragma endregion Reader functions
+
+///////////////////////////////////////////////////////////////////////////////
+// LDerivation: Lazy derivation of an L-system
+
+#pragma region LDerivation
+
+/// The stack is reserved for the maximum depth, so it is never reallocated
+/// while reading.
+/// \param lsys An L-system.
+/// \param n The number of generations.
+
+LDerivation::LDerivation(const LSystem& lsys, UINT n):
+  m_pLSystem(&lsys), m_nGenerations(n){
+  m_vStack.reserve(n + 1);
+  Reset();
+} //constructor
+
+/// Restart the derivation from the first symbol by putting the root alone
+/// on the stack.
+
+void LDerivation::Reset(){
+  m_vStack.clear();
+  m_vStack.push_back(m_pLSystem->GetRootFrame());
+} //Reset
+
+/// Push a frame for the expansion of a symbol in the top frame. The
+/// production is chosen using the symbol's key, which is made from the key
+/// of the top frame and the symbol's offset in it, as in LSystem::Derive().
+/// If no production is chosen, then the frame holds the symbol itself.
+/// \param p Pointer to a symbol in the top frame that has a production.
+
+void LDerivation::Expand(const char* p){
+  const LSystem& lsys = *m_pLSystem; //shorthand
+  const LDeriveFrame& f = m_vStack.back(); //top of stack
+
+  const ULONGLONG key = lsys.m_bStochastic?
+    CRandom::SubKey(f.m_nKey, p - f.m_pBegin): 0; //key of *p
+  const LCompiledRule* rule = lsys.Choose(*p, key); //production to apply
+
+  LDeriveFrame g; //frame for right-hand side of rule
+  g.m_pBegin = g.m_pNext = rule? lsys.m_strArena.data() + rule->m_nOffset: p;
+  g.m_pEnd = g.m_pNext + (rule? rule->m_nLength: 1);
+  g.m_nKey = key;
+  m_vStack.push_back(g); //expand *p
+} //Expand
+
+/// Get the next symbol of the derivation. Symbols at the top of the stack are
+/// expanded until one is found that is either a constant or is in the
+/// final generation, that is, at depth \f$n\f$. Frames whose strings have
+/// been used up are popped.
+/// \param c [out] The next symbol, if there is one.
+/// \return true if there was a next symbol, false at the end.
+
+bool LDerivation::Next(char& c){
+  while(!m_vStack.empty()){
+    LDeriveFrame& f = m_vStack.back(); //top of stack
+
+    if(f.m_pNext == f.m_pEnd){ //string used up
+      m_vStack.pop_back();
+      continue;
+    } //if
+
+    const char* p = f.m_pNext++; //next symbol at this depth
+    c = *p;
+
+    if(m_vStack.size() > m_nGenerations)
+      return true; //final generation
+
+    if(!m_pLSystem->IsRewritten(c))
+      return true; //c is a constant
+
+    Expand(p);
+  } //while
+
+  return false; //end of derivation
+} //Next
+
+/// Move the derivation to a given symbol, so that the next call to Next()
+/// gets it, without reading the symbols before it. The expanded lengths from
+/// LSystem::GetLengthTable() say how many symbols of the final generation
+/// each symbol on the stack produces, so at each depth the symbols that
+/// come entirely before the target can be skipped and the one that contains
+/// it can be expanded. This takes time proportional to the number of
+/// generations times the length of the right-hand sides. The table is
+/// computed on the first call and kept for later ones.
+///
+/// The expanded lengths of a stochastic L-system depend on the productions
+/// chosen, so instead the expansion of each symbol that is skipped is
+/// measured with LSystem::Measure(). This takes time proportional to the
+/// length of the generation before the target, at worst.
+/// \param k Index of a symbol in the final generation, starting at zero.
+/// \return true if there is such a symbol, false if the derivation is empty
+/// or has \f$k\f$ or fewer symbols. In the latter case the derivation is
+/// left at its end.
+
+bool LDerivation::Seek(size_t k){
+  const LSystem& lsys = *m_pLSystem; //shorthand
+  const bool bStochastic = lsys.m_bStochastic; //whether to measure
+
+  if(!bStochastic && m_vLength.empty()) //first time
+    lsys.GetLengthTable(m_nGenerations, m_vLength);
+
+  std::vector<LDeriveFrame> scratch; //stack for measuring, if stochastic
+  Reset();
+
+  while(true){
+    LDeriveFrame& f = m_vStack.back(); //top of stack
+    const UINT depth = (UINT)m_vStack.size() - 1; //depth of frame f
+    const UINT left = m_nGenerations - depth; //generations below frame f
+    const size_t* len = bStochastic? nullptr: &m_vLength[left*NUM_LSYMBOLS];
+
+    for(; f.m_pNext<f.m_pEnd; f.m_pNext++){ //skip symbols before the target
+      const char* p = f.m_pNext; //current symbol
+
+      LDeriveFrame g = f; //frame holding only *p
+      g.m_pEnd = p + 1;
+
+      const size_t n = bStochastic? lsys.Measure(g, left, scratch):
+        len[(unsigned char)*p]; //its expansion
+
+      if(k < n)break; //target is in the expansion of *p
+      k -= n;
+    } //for
+
+    if(f.m_pNext == f.m_pEnd){ //ran off the end
+      m_vStack.clear();
+      return false;
+    } //if
+
+    const char* p = f.m_pNext; //the symbol whose expansion has the target
+
+    if(depth == m_nGenerations)
+      return true; //final generation
+
+    if(!lsys.IsRewritten(*p))
+      return true; //*p is a constant
+
+    f.m_pNext++; //*p is expanded below, so skip it at this depth
+    Expand(p);
+  } //while
+} //Seek
+
+#pragma endregion LDerivation
+
+///////////////////////////////////////////////////////////////////////////////
+// Random access
+
+#pragma region Random access
+
+/// Get a symbol of a generation of an L-system without generating the
+/// string (see LDerivation::Seek()).
+/// \param n The number of generations.
+/// \param k Index of a symbol in generation \f$n\f$, starting at zero.
+/// \param c [out] The symbol at index \f$k\f$, if there is one.
+/// \return true if there is such a symbol, false if there are \f$k\f$ or
+/// fewer symbols.
+
+bool LSystem::GetSymbol(UINT n, size_t k, char& c) const{
+  LDerivation d(*this, n); //derivation of generation n
+  return d.Seek(k) && d.Next(c);
+} //GetSymbol
+
+#pragma endregion Random access
@@ -26,6 +26,9 @@
 #pragma once
 
 #include "Random.h"
+#include "RingBuffer.h"
+#include "Compressed.h"
+#include "SpillFile.h"
 #include "Includes.h"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,14 +46,98 @@
 class LProduction{
   public:
     char m_chLHS = '\0'; ///< Left-hand side of production.
-    std::wstring m_wstrRHS; ///< Right-hand side of production.
+    std::string m_strRHS; ///< Right-hand side of production.
     float m_fProb; ///< Probability of production applying.
 
     LProduction(char lhs, const std::wstring rhs, float fProb=1); ///< Constructor.
+    LProduction(char lhs, const std::string& rhs, float fProb=1); ///< Constructor.
 }; //LProduction
 
 #pragma endregion LProduction
 
+////////////////////////////////////////////////////////////////////////////////
+// Compiled rule table
+
+#pragma region Compiled rule table
+
+#define NUM_LSYMBOLS 256 ///< Number of entries in the dense rule table.
+#define LSYS_PARALLEL_MIN 65536 ///< Shortest generation rewritten in parallel.
+#define LSYS_SIMD_SYMBOLS 8 ///< Most rewritten symbols for a SIMD scan.
+#define LSYS_FRONTIER_MIN 4096 ///< Fewest symbols to split a derivation into.
+
+/// \brief Compiled production.
+///
+/// A production as stored in the compiled rule table. The right-hand side is
+/// not stored here, but as a range of characters in an arena string shared
+/// by all of the compiled productions.
+
+class LCompiledRule{
+  public:
+    size_t m_nOffset = 0; ///< Offset of right-hand side in arena.
+    size_t m_nLength = 0; ///< Length of right-hand side.
+    float m_fProb = 1; ///< Probability of production applying.
+}; //LCompiledRule
+
+/// \brief Rule table entry.
+///
+/// An entry in the compiled rule table, which is indexed by left-hand side.
+/// It records the range of compiled productions that have that left-hand
+/// side. A symbol with no productions has a count of zero.
+
+class LRuleRange{
+  public:
+    UINT m_nFirst = 0; ///< Index of first compiled production.
+    UINT m_nCount = 0; ///< Number of compiled productions.
+    UINT m_nAlias = 0; ///< Index of first alias table entry.
+    UINT m_nSlots = 0; ///< Number of alias table entries.
+}; //LRuleRange
+
+/// \brief Alias table entry.
+///
+/// An entry in a Walker alias table, used to choose a stochastic production
+/// with a single random draw (see LSystem::Choose()). A draw picks an entry
+/// and a fraction. If the fraction is below the threshold then the entry's
+/// own outcome is chosen, otherwise its alias. Outcome \f$k\f$ is the
+/// \f$k\f$th production for the left-hand side, and outcome `m_nCount` of
+/// the LRuleRange means that the symbol is copied unchanged.
+
+class LAliasEntry{
+  public:
+    UINT m_nThreshold = 0; ///< Threshold, a fraction of \f$2^{32}\f$.
+    UINT m_nAlias = 0; ///< Outcome when the fraction is above the threshold.
+}; //LAliasEntry
+
+/// \brief Expansion cache statistics.
+///
+/// Statistics for the cache of expansions used by LSystem::GenerateMemo().
+/// A miss is an expansion built from scratch, a hit is a copy of one.
+
+class LMemoStats{
+  public:
+    size_t m_nHits = 0; ///< Number of expansions copied from the cache.
+    size_t m_nMisses = 0; ///< Number of expansions built.
+    size_t m_nBytesSaved = 0; ///< Bytes copied instead of rewritten.
+}; //LMemoStats
+
+/// \brief Derivation frame.
+///
+/// A string being expanded by a depth-first derivation (see LSystem::Derive()
+/// and LDerivation): the range of its characters that have yet to be
+/// expanded, where the string starts, and the key of the symbol that it is
+/// the expansion of. The key of the character at `p` is the SubKey() of
+/// that key and `p - m_pBegin` (see CRandom::SubKey()). Keys are used only
+/// by stochastic L-systems.
+
+class LDeriveFrame{
+  public:
+    const char* m_pBegin = nullptr; ///< First character of the string.
+    const char* m_pNext = nullptr; ///< Next character.
+    const char* m_pEnd = nullptr; ///< One past the last character.
+    ULONGLONG m_nKey = 0; ///< Key of the symbol that was expanded.
+}; //LDeriveFrame
+
+#pragma endregion Compiled rule table
+
 ////////////////////////////////////////////////////////////////////////////////
 // class LSystem
 
@@ -64,36 +151,234 @@ class LProduction{
 /// left-hand side of a production to an `std::vector` of the productions that 
 /// have that left-hand side. A text string m_wstrRuleString is used to store
 /// a printable rule string in text form which is used to display the rules
-/// on the window. Double-buffering in `m_wstrBuffer[2]` is used to generate the
+/// on the window. Double-buffering in `m_strBuffer[2]` is used to generate the
 /// result string `m_pResult`.
+///
+/// The map is convenient for adding rules but slow to search once per symbol,
+/// so AddRule() also compiles the productions into a dense table
+/// `m_cRuleTable` indexed by left-hand side. The right-hand sides of all
+/// productions are stored contiguously in `m_strArena`, which means that
+/// rewriting a symbol costs a table load and a bulk copy. Symbols without
+/// productions are constants, and runs of them are found with a bitmask (and
+/// SIMD if possible) and copied in one operation.
+///
+/// Each generation buffer is reserved once, before it is written, so that
+/// Generate() never reallocates. For deterministic rules the exact lengths
+/// come from a table of the expanded length of each symbol, and a stochastic
+/// derivation is measured by a counting pass that makes the same choices
+/// before it is written. The table of expanded lengths also gives
+/// GetPredictedLength() and GetPredictedMemory(), which can be used to
+/// decide whether a generation is affordable before generating it.
+///
+/// Long generations of a deterministic L-system can be split into chunks and
+/// rewritten on several threads (see SetThreads()) with the same result.
+/// Deterministic L-systems expand the same symbol by the same number of
+/// generations over and over, so usually they are generated from a cache
+/// that expands each symbol once for each number of generations (see
+/// GenerateMemo()).
+///
+/// The production applied to a symbol of a stochastic L-system depends only
+/// on the seed and the symbol's derivation path, that is, where it is in
+/// the right-hand side that it came from, where that symbol was in its
+/// own right-hand side, and so on back to the root (see Choose()). It does
+/// not depend on the order in which symbols are expanded, so a stochastic
+/// L-system is generated by a depth-first derivation of the root (see
+/// Derive()), which can be split among threads, read lazily with an
+/// LDerivation, or started at any symbol. Every occurrence of a symbol has
+/// its own path, so there is nothing for the expansion cache to share.
+///
+/// The result of the last call to Generate() is kept, so asking for the
+/// same generation again costs nothing. For deterministic L-systems, asking
+/// for a later generation costs only the extra passes, and optionally
+/// earlier generations are kept as checkpoints under a memory budget, so
+/// that stepping back is cheap too.
+/// An L-system can also be read one symbol at a time, without generating
+/// the string, using an LDerivation, starting at any symbol.
+///
+/// The last generation is usually the largest by far. Generate() can defer
+/// it, in which case Stream() rewrites the previous generation into a
+/// CRingBuffer to be read by another thread. The last generation is then
+/// never stored, and the reader does not have to wait for it to be finished.
+/// A deterministic L-system can instead be generated by Compress(), which
+/// stores the result as an LCompressed whose size grows only linearly with
+/// the number of generations. Generations too long to keep in memory at
+/// all can be spilled to files (see SetMemoryBudget()).
+/// An LGrowth predicts the length and cost of a generation from the
+/// production matrix, so that requests that are too large can be refused.
 
 class LSystem{
+  friend class LDerivation;
+  friend class LCompressed;
+  friend class LGrowth;
+
   private: 
     CRandom m_cRandom; ///< PRNG.
 
-    std::wstring m_wstrRoot; ///< Root string.
+    std::string m_strRoot; ///< Root string.
 
-    std::map<wchar_t, std::vector<LProduction>> m_mapRules; ///< Productions.
+    std::map<char, std::vector<LProduction>> m_mapRules; ///< Productions.
     std::wstring m_wstrRuleString; ///< Rule string.
 
-    std::wstring m_wstrBuffer[2]; ///< Generation buffers.
-    std::wstring* m_pResult = m_wstrBuffer; ///< Pointer to generated string.
+    LRuleRange m_cRuleTable[NUM_LSYMBOLS]; ///< Compiled rule table.
+    std::vector<LCompiledRule> m_vCompiled; ///< Compiled productions.
+    std::vector<LAliasEntry> m_vAlias; ///< Alias tables for all left-hand sides.
+    std::string m_strArena; ///< Right-hand sides of compiled productions.
+    UINT m_uRewritten[NUM_LSYMBOLS/32] = {0}; ///< Bitmask of symbols with productions.
+    std::vector<char> m_vRewritten; ///< Symbols with productions.
+
+    std::string m_strBuffer[2]; ///< Generation buffers.
+    std::string* m_pResult = m_strBuffer; ///< Pointer to generated string.
 
     bool m_bStochastic = false; ///< Includes a stochastic rule.
     UINT m_nGenerations = 0; ///< Number of generations.
+    UINT m_nThreads = 1; ///< Number of threads used by Generate().
+    bool m_bDeferred = false; ///< Last generation deferred to Stream().
+    bool m_bMemoize = true; ///< Use expansion cache if deterministic.
+    LMemoStats m_cMemoStats; ///< Expansion cache statistics.
+
+    bool m_bCurrent = false; ///< Whether `*m_pResult` is valid.
+    UINT m_nCurrent = 0; ///< Number of generations in `*m_pResult`.
+    std::map<UINT, std::string> m_mapCheckpoints; ///< Saved generations.
+    size_t m_nCheckpointBytes = 0; ///< Memory used by checkpoints.
+    size_t m_nCheckpointBudget = 0; ///< Memory allowed for checkpoints.
+
+    LCompressed m_cCompressed; ///< Compressed result.
+    bool m_bCompressed = false; ///< Whether the result is `m_cCompressed`.
+
+    size_t m_nMemoryBudget = SIZE_MAX; ///< Longest generation kept in memory.
+    CSpillFile m_cSpill[2]; ///< Spill files.
+    CSpillFile* m_pSpill = nullptr; ///< Spill file holding the result, if any.
+
+    void Compile(); ///< Compile rules into the rule table.
+    void CompileAlias(LRuleRange& r); ///< Build an alias table.
+    const LCompiledRule* Choose(char c, ULONGLONG key) const; ///< Choose production.
+    size_t ConstantRun(const char* p, size_t n) const; ///< Count constants.
+
+    /// \brief Whether a symbol has a production.
+    /// \param c A symbol.
+    /// \return true if c has at least one production.
+
+    bool IsRewritten(char c) const{
+      const UINT u = (unsigned char)c; //index into the rule table
+      return (m_uRewritten[u >> 5] >> (u & 31)) & 1;
+    } //IsRewritten
+
+    /// \brief First production for a symbol.
+    /// \param c A symbol.
+    /// \return Pointer to the first production for c, nullptr if none.
+
+    const LCompiledRule* GetRule(char c) const{
+      const LRuleRange& r = m_cRuleTable[(unsigned char)c]; //table entry for c
+      return (r.m_nCount > 0)? &m_vCompiled[r.m_nFirst]: nullptr;
+    } //GetRule
+
+    void Rewrite(const std::string& src, std::string& dest); ///< Rewrite once.
+    void RewriteParallel(const std::string& src, std::string& dest); ///< Rewrite once in parallel.
+    void PredictLengths(UINT n, std::vector<size_t>& v) const; ///< Predict lengths.
+    void GetLengthTable(UINT n, std::vector<size_t>& v) const; ///< Expanded lengths.
+    void GetReachable(std::vector<bool>& v) const; ///< Reachable symbols.
+    void GenerateMemo(const std::string& src, const UINT n,
+      std::string& dest); ///< Generate from cache.
+    void AssembleParallel(const std::string& src, const UINT n,
+      const std::vector<std::string>& memo, const std::vector<size_t>& table,
+      std::string& dest); ///< Assemble from cache in parallel.
+
+    LDeriveFrame GetRootFrame() const; ///< Frame for the root.
+    template<class F> void Derive(const LDeriveFrame& f, const UINT k,
+      std::vector<LDeriveFrame>& stack, F& sink) const; ///< Derive a string.
+    size_t Measure(const LDeriveFrame& f, const UINT k,
+      std::vector<LDeriveFrame>& stack) const; ///< Length of a derivation.
+    UINT GetFrontier(const UINT n, std::vector<LDeriveFrame>& v) const; ///< Split a derivation.
+    void GenerateDerived(const UINT n); ///< Generate by derivation.
+
+    void ReadResult(const std::string& src,
+      const std::function<void(const char*, size_t, size_t)>& f); ///< Read result in windows.
+    void RewriteSpill(const std::string& src, CSpillFile& dest); ///< Rewrite once into a file.
+    bool Spill(const std::string& src); ///< Rewrite result into a spill file.
+    void Unspill(); ///< Discard spill files.
+
+    UINT Resume(const UINT n); ///< Find where to start generating.
+    void Checkpoint(const UINT n, const std::string& s); ///< Keep a checkpoint.
+    void Invalidate(); ///< Discard result and checkpoints.
 
   public:
     void SetRoot(const std::wstring& omega); ///< Set the root string.
     void AddRule(const LProduction& rule); ///< AddRule rule.
 
     void Clear(); ///< Clear the rules, buffers, and settings.
-    void Generate(const UINT n); ///< Generate L-system from stored root and rules.
+    void SetThreads(UINT n); ///< Set number of threads.
+    void SetMemoize(bool b); ///< Use expansion cache.
+    void SetCheckpointBudget(size_t n); ///< Set checkpoint memory budget.
+    void SetMemoryBudget(size_t n); ///< Set generation memory budget.
+    void SetSeed(int seed); ///< Seed the PRNG.
+    void SetResult(const std::string& s, const UINT n); ///< Set result string.
+    void SetResult(std::string&& s, const UINT n); ///< Set result string.
+    void Generate(const UINT n, const bool bDefer=false); ///< Generate L-system from stored root and rules.
+    void Stream(CRingBuffer<char>& ring); ///< Stream generated string.
+    void Compress(const UINT n); ///< Generate in compressed form.
 
-    const std::wstring& GetString() const; ///< Get generated string.
+    const std::string& GetString() const; ///< Get generated string.
+    const LCompressed& GetCompressed() const; ///< Get compressed string.
     const std::wstring& GetRuleString() const; ///< Get rule string.
     const UINT GetGenerations() const; ///< Get number of generations.
 
+    size_t GetPredictedLength(UINT n) const; ///< Predicted string length.
+    size_t GetPredictedMemory(UINT n) const; ///< Predicted buffer size.
+    bool GetSymbol(UINT n, size_t k, char& c) const; ///< Get symbol at index.
+
     const bool IsStochastic() const; ///< Is a stochastic L-system.
+    const bool IsDeferred() const; ///< Is last generation deferred.
+    const bool IsCompressed() const; ///< Is result compressed.
+    const bool IsSpilled() const; ///< Is result spilled to a file.
+    const LMemoStats& GetMemoStats() const; ///< Get cache statistics.
+    ULONGLONG GetHash() const; ///< Hash of root and rules.
 }; //LSystem
 
 #pragma endregion LSystem
+
+////////////////////////////////////////////////////////////////////////////////
+// class LDerivation
+
+#pragma region LDerivation
+
+/// \brief Lazy derivation of an L-system.
+///
+/// Reads the symbols of a generation of an LSystem in order without
+/// generating it. The symbols are found by a depth-first expansion of the
+/// root, using an explicit stack with one frame per generation. Each frame
+/// holds the range of characters remaining in a string that is being
+/// expanded: the root in frame 0, and a right-hand side of a production from
+/// the LSystem's compiled rule table in the other frames. The memory used
+/// is therefore proportional to the number of generations, rather than to
+/// the length of the string, which grows exponentially.
+///
+/// The derivation can also be started at any index, which makes it possible
+/// to sample a huge generation or to divide it among several workers. Seek()
+/// uses a table of the expanded length of each symbol after each number of
+/// generations to descend directly to the frame that holds the target.
+///
+/// A stochastic L-system is derived the same way, with each frame holding
+/// the key of the symbol that it expands, so that the productions are
+/// chosen as LSystem::Generate() chooses them. Its expanded lengths depend
+/// on the choices, so Seek() measures the expansion of each symbol that it
+/// skips instead of looking it up. The LSystem must not be changed while it
+/// is being derived.
+
+class LDerivation{
+  private:
+    const LSystem* m_pLSystem = nullptr; ///< L-system being derived.
+    UINT m_nGenerations = 0; ///< Number of generations.
+    std::vector<LDeriveFrame> m_vStack; ///< Expansion stack.
+    std::vector<size_t> m_vLength; ///< Expanded length table, if needed.
+
+    void Expand(const char* p); ///< Push the expansion of a symbol.
+
+  public:
+    LDerivation(const LSystem& lsys, UINT n); ///< Constructor.
+
+    void Reset(); ///< Restart from the first symbol.
+    bool Next(char& c); ///< Get next symbol.
+    bool Seek(size_t k); ///< Move to symbol at index.
+}; //LDerivation
+
+#pragma endregion LDerivation
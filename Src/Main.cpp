@@ -71,6 +71,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam){
       else switch(nMenuId){  //now the other manu entries
         case IDM_FILE_GENERATE: //generate a stochastic L-system
           if(g_pMain->IsStochastic()){
+            g_pMain->NewSeed();
             g_pMain->Generate();
             g_pMain->Draw();
           } //if
@@ -0,0 +1,533 @@
+/// \file Preset.h
+/// \brief Interface and code for the built-in L-systems LPreset.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#pragma once
+
+#include "Includes.h"
+#include "Types.h"
+#include "Lsystem.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Compile-time production
+
+#pragma region Compile-time production
+
+/// \brief Compile-time production.
+///
+/// A production whose right-hand side is a string literal, so that its
+/// symbols and length are known to the compiler. The default production has
+/// a null left-hand side, which is used to mean that there is no production.
+
+class LPresetRule{
+  public:
+    char m_chLHS = '\0'; ///< Left-hand side of production.
+    const char* m_pRHS = ""; ///< Right-hand side of production.
+    size_t m_nLength = 0; ///< Length of right-hand side.
+    float m_fProb = 1; ///< Probability of production applying.
+
+    constexpr LPresetRule(){}; ///< Default constructor.
+
+    /// \brief Constructor.
+    ///
+    /// \param lhs Left-hand side of production.
+    /// \param rhs Right-hand side of production, a string literal.
+    /// \param fProb Production probability (defaults to 1).
+
+    template<size_t N> constexpr LPresetRule(char lhs, const char (&rhs)[N],
+      float fProb=1): m_chLHS(lhs), m_pRHS(rhs), m_nLength(N - 1),
+      m_fProb(fProb){
+    }; //constructor
+}; //LPresetRule
+
+#pragma endregion Compile-time production
+
+///////////////////////////////////////////////////////////////////////////////
+// Grammars
+
+#pragma region Grammars
+
+/// \brief Stochastic branching structure from ABOP p. 28.
+
+class LPresetBranching{
+  public:
+    static constexpr const char* Root(){return "F";}; ///< Root.
+    static constexpr size_t NumRules(){return 3;}; ///< Number of productions.
+    static constexpr float Angle(){return 21.2f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 8.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 5;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \param i Index of production.
+    /// \return Production i.
+
+    static constexpr LPresetRule Rule(size_t i){
+      return (i == 0)? LPresetRule('F', "F[+F]F[-F]F", 0.33f):
+             (i == 1)? LPresetRule('F', "F[+F]F", 0.33f):
+                       LPresetRule('F', "F[-F]F", 0.34f);
+    } //Rule
+}; //LPresetBranching
+
+/// \brief Plant from ABOP Fig. 1.24a.
+
+class LPresetPlantA{
+  public:
+    static constexpr const char* Root(){return "F";}; ///< Root.
+    static constexpr size_t NumRules(){return 1;}; ///< Number of productions.
+    static constexpr float Angle(){return 22.7f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 8.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 4;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \return The only production.
+
+    static constexpr LPresetRule Rule(size_t){
+      return LPresetRule('F', "F[+F]F[-F]F");
+    } //Rule
+}; //LPresetPlantA
+
+/// \brief Plant from ABOP Fig. 1.24b.
+
+class LPresetPlantB{
+  public:
+    static constexpr const char* Root(){return "F";}; ///< Root.
+    static constexpr size_t NumRules(){return 1;}; ///< Number of productions.
+    static constexpr float Angle(){return 20.0f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 20.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 4;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \return The only production.
+
+    static constexpr LPresetRule Rule(size_t){
+      return LPresetRule('F', "F[+F]F[-F][F]");
+    } //Rule
+}; //LPresetPlantB
+
+/// \brief Plant from ABOP Fig. 1.24c.
+
+class LPresetPlantC{
+  public:
+    static constexpr const char* Root(){return "F";}; ///< Root.
+    static constexpr size_t NumRules(){return 1;}; ///< Number of productions.
+    static constexpr float Angle(){return 22.5f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 12.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 4;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \return The only production.
+
+    static constexpr LPresetRule Rule(size_t){
+      return LPresetRule('F', "FF-[-F+F+F]+[+F-F-F]");
+    } //Rule
+}; //LPresetPlantC
+
+/// \brief Plant from ABOP Fig. 1.24d.
+
+class LPresetPlantD{
+  public:
+    static constexpr const char* Root(){return "X";}; ///< Root.
+    static constexpr size_t NumRules(){return 2;}; ///< Number of productions.
+    static constexpr float Angle(){return 20.0f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 5.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 6;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \param i Index of production.
+    /// \return Production i.
+
+    static constexpr LPresetRule Rule(size_t i){
+      return (i == 0)? LPresetRule('X', "F[+X]F[-X]+X"):
+                       LPresetRule('F', "FF");
+    } //Rule
+}; //LPresetPlantD
+
+/// \brief Plant from ABOP Fig. 1.24e.
+
+class LPresetPlantE{
+  public:
+    static constexpr const char* Root(){return "X";}; ///< Root.
+    static constexpr size_t NumRules(){return 2;}; ///< Number of productions.
+    static constexpr float Angle(){return 25.7f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 5.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 6;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \param i Index of production.
+    /// \return Production i.
+
+    static constexpr LPresetRule Rule(size_t i){
+      return (i == 0)? LPresetRule('X', "F[+X][-X]FX"):
+                       LPresetRule('F', "FF");
+    } //Rule
+}; //LPresetPlantE
+
+/// \brief Plant from ABOP Fig. 1.24f.
+
+class LPresetPlantF{
+  public:
+    static constexpr const char* Root(){return "X";}; ///< Root.
+    static constexpr size_t NumRules(){return 2;}; ///< Number of productions.
+    static constexpr float Angle(){return 22.5f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 16.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 4;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \param i Index of production.
+    /// \return Production i.
+
+    static constexpr LPresetRule Rule(size_t i){
+      return (i == 0)? LPresetRule('X', "F-[ [X]+X]+F[+FX]-X"):
+                       LPresetRule('F', "FF");
+    } //Rule
+}; //LPresetPlantF
+
+/// \brief Hexagonal Gosper curve from ABOP Fig. 1.11a.
+
+class LPresetHexGosper{
+  public:
+    static constexpr const char* Root(){return "L";}; ///< Root.
+    static constexpr size_t NumRules(){return 2;}; ///< Number of productions.
+    static constexpr float Angle(){return 60.0f;}; ///< Angle delta in degrees.
+    static constexpr float Length(){return 12.0f;}; ///< Line length.
+    static constexpr UINT Generations(){return 4;}; ///< Generations to draw.
+
+    /// \brief Production.
+    /// \param i Index of production.
+    /// \return Production i.
+
+    static constexpr LPresetRule Rule(size_t i){
+      return (i == 0)? LPresetRule('L', "L+R++R-L--LL-R+"):
+                       LPresetRule('R', "-L+RR++R+L--L-R");
+    } //Rule
+}; //LPresetHexGosper
+
+#pragma endregion Grammars
+
+///////////////////////////////////////////////////////////////////////////////
+// Compile-time turtle graphics tables
+
+#pragma region Compile-time turtle graphics tables
+
+/// \brief Compile-time turtle graphics tables.
+///
+/// The tables that a CTurtle would otherwise make when it is constructed,
+/// made by the compiler for a grammar (see LPreset::GetTurtleDesc()): the
+/// action of each symbol in the grammar's alphabet, and the sine and cosine
+/// of each heading if the angle delta divides a full circle into a whole
+/// number of turns. The sines and cosines are sums of Taylor series in
+/// double precision, which are rounded to float just as the turtle rounds
+/// those of the standard library.
+
+class LPresetTables{
+  public:
+    unsigned char m_nAction[256] = {0}; ///< Action of each symbol.
+    unsigned m_nHeadings = 0; ///< Number of headings, 0 if no direction table.
+    float m_fSin[TURTLE_HEADINGS_MAX] = {0}; ///< Sine of each heading.
+    float m_fCos[TURTLE_HEADINGS_MAX] = {0}; ///< Cosine of each heading.
+
+    constexpr LPresetTables(){}; ///< Default constructor.
+
+    /// \brief Sine.
+    /// \param x An angle in radians, between \f$-\pi\f$ and \f$\pi\f$.
+    /// \return The sine of x.
+
+    static constexpr double Sin(double x){
+      double term = x; //current term of the series
+      double sum = x; //sum of the terms so far
+
+      for(int k=1; k<20; k++){ //enough terms for double precision
+        term *= -x*x/((2*k)*(2*k + 1));
+        sum += term;
+      } //for
+
+      return sum;
+    } //Sin
+
+    /// \brief Cosine.
+    /// \param x An angle in radians, between \f$-\pi\f$ and \f$\pi\f$.
+    /// \return The cosine of x.
+
+    static constexpr double Cos(double x){
+      double term = 1; //current term of the series
+      double sum = 1; //sum of the terms so far
+
+      for(int k=1; k<20; k++){ //enough terms for double precision
+        term *= -x*x/((2*k - 1)*(2*k));
+        sum += term;
+      } //for
+
+      return sum;
+    } //Cos
+
+    /// \brief Number of headings.
+    ///
+    /// The number of turns of an angle delta that make a full circle, found
+    /// the same way as the CTurtle constructor finds it.
+    /// \param angle Angle delta in degrees.
+    /// \return Number of headings, 0 if there is no direction table.
+
+    static constexpr unsigned Headings(float angle){
+      const float radians = float(TURTLE_PI)*angle/180; //as in TurtleDesc
+      const double delta = (radians < 0)? -(double)radians: radians; //size of a turn
+
+      if(delta == 0)return 0;
+
+      const double k = 2*TURTLE_PI/delta; //number of turns in a circle
+      if(k + 0.5 > TURTLE_HEADINGS_MAX + 1)return 0;
+
+      const double n = (double)(unsigned)(k + 0.5); //nearest whole number
+      const double e = (k > n)? k - n: n - k; //distance from it
+
+      return (n >= 1 && e < 1e-5*n)? (unsigned)n: 0;
+    } //Headings
+
+    /// \brief Fill in the direction table.
+    /// \param angle Angle delta in degrees.
+
+    constexpr void SetAngle(float angle){
+      m_nHeadings = Headings(angle);
+
+      for(unsigned j=0; j<m_nHeadings; j++){
+        double a = 2*TURTLE_PI*j/m_nHeadings; //angle of heading j
+        if(a > TURTLE_PI)a -= 2*TURTLE_PI; //into the range of the series
+
+        m_fSin[j] = (float)Sin(a);
+        m_fCos[j] = (float)Cos(a);
+      } //for
+    } //SetAngle
+
+    /// \brief Add the actions of the symbols in a string.
+    /// \param p Pointer to the string.
+    /// \param n Length of the string.
+
+    constexpr void AddActions(const char* p, size_t n){
+      for(size_t i=0; i<n; i++)
+        m_nAction[(unsigned char)p[i]] = TurtleAction(p[i]);
+    } //AddActions
+}; //LPresetTables
+
+#pragma endregion Compile-time turtle graphics tables
+
+///////////////////////////////////////////////////////////////////////////////
+// LPreset
+
+#pragma region LPreset
+
+/// \brief Built-in L-system.
+///
+/// Code specialized for one of the grammars above. The grammar is a template
+/// parameter, so its productions, right-hand side lengths, constants, and
+/// turtle graphics settings are all compile-time constants, and so is the
+/// number of generations to draw. The compiler turns the production lookup
+/// in Find() into a few comparisons against fixed symbols, instead of going
+/// through the rule table of an LSystem. Generate() only works for
+/// deterministic grammars, that is, those for which IsStochastic() is false.
+/// CMain generates strings with an LSystem loaded by SetRules(), so that
+/// they get its expansion cache and checkpoints; Generate() is kept as the
+/// baseline that the benchmark in `Bench` measures the LSystem against.
+/// \tparam P Grammar class with the members of LPresetPlantA.
+
+template<class P> class LPreset{
+  private:
+    /// \brief Find the production for a symbol.
+    /// \param c A symbol.
+    /// \return Index of the first production for c, `P::NumRules()` if none.
+
+    static constexpr size_t Find(char c){
+      size_t i = 0; //index of production
+
+      while(i < P::NumRules() && P::Rule(i).m_chLHS != c)
+        i++;
+
+      return i;
+    } //Find
+
+    /// \brief Append the expansion of a string.
+    ///
+    /// Append the expansion of a string to another, given the expansions of
+    /// the left-hand sides. Constants are copied unchanged.
+    /// \param s [in, out] String to append to.
+    /// \param p Pointer to the string to be expanded.
+    /// \param n Length of the string to be expanded.
+    /// \param v Expansion of the left-hand side of each production.
+
+    static void Append(std::string& s, const char* p, size_t n,
+      const std::vector<std::string>& v){
+      for(size_t i=0; i<n; i++){ //for each symbol
+        const size_t j = Find(p[i]); //index of production for p[i]
+        if(j < P::NumRules())s.append(v[j]); //expand
+        else s.push_back(p[i]); //constant
+      } //for
+    } //Append
+
+    /// \brief Length of the expansion of a string.
+    /// \param p Pointer to a string.
+    /// \param n Length of the string.
+    /// \param v Expanded length of the left-hand side of each production.
+    /// \return Length of the expansion.
+
+    static size_t Sum(const char* p, size_t n, const std::vector<size_t>& v){
+      size_t total = 0; //result
+
+      for(size_t i=0; i<n; i++){ //for each symbol
+        const size_t j = Find(p[i]); //index of production for p[i]
+        total += (j < P::NumRules())? v[j]: 1;
+      } //for
+
+      return total;
+    } //Sum
+
+  public:
+    /// \brief Whether the grammar has a stochastic production.
+    /// \return true if some production has probability less than 1.
+
+    static constexpr bool IsStochastic(){
+      for(size_t i=0; i<P::NumRules(); i++)
+        if(P::Rule(i).m_fProb < 1)
+          return true;
+
+      return false;
+    } //IsStochastic
+
+    /// \brief Load the grammar into an LSystem.
+    /// \param lsys [out] An L-system, which is cleared first.
+
+    static void SetRules(LSystem& lsys){
+      lsys.Clear();
+      lsys.SetRoot(std::wstring(P::Root(), P::Root() + strlen(P::Root())));
+
+      for(size_t i=0; i<P::NumRules(); i++){ //for each production
+        const LPresetRule r = P::Rule(i);
+        lsys.AddRule(LProduction(r.m_chLHS,
+          std::string(r.m_pRHS, r.m_nLength), r.m_fProb));
+      } //for
+    } //SetRules
+
+    /// \brief Make the turtle graphics tables.
+    /// \return Action and direction tables for the grammar.
+
+    static constexpr LPresetTables MakeTables(){
+      LPresetTables t; //result
+      t.SetAngle(P::Angle());
+
+      size_t n = 0; //length of root
+      while(P::Root()[n])n++;
+      t.AddActions(P::Root(), n);
+
+      for(size_t i=0; i<P::NumRules(); i++){ //for each production
+        const LPresetRule r = P::Rule(i);
+        t.AddActions(&r.m_chLHS, 1);
+        t.AddActions(r.m_pRHS, r.m_nLength);
+      } //for
+
+      return t;
+    } //MakeTables
+
+    /// \brief Get the turtle graphics descriptor.
+    ///
+    /// The descriptor points to tables made at compile time by MakeTables(),
+    /// so that a turtle made from it does not have to make them.
+    /// \return Turtle graphics descriptor for the grammar.
+
+    static TurtleDesc GetTurtleDesc(){
+      static constexpr LPresetTables t = MakeTables(); //baked tables
+
+      TurtleDesc d(P::Angle(), P::Length()); //result
+      d.m_pAction = t.m_nAction;
+      d.m_nHeadings = t.m_nHeadings;
+      d.m_pSin = t.m_fSin;
+      d.m_pCos = t.m_fCos;
+
+      return d;
+    } //GetTurtleDesc
+
+    /// \brief Length of a generation.
+    /// \param n Number of generations.
+    /// \return Length of generation n.
+
+    static size_t GetLength(UINT n){
+      std::vector<size_t> len(P::NumRules(), 1); //expanded length of each lhs
+      std::vector<size_t> next(P::NumRules()); //the same one generation later
+
+      for(UINT k=0; k<n; k++){ //for each generation
+        for(size_t j=0; j<P::NumRules(); j++)
+          next[j] = Sum(P::Rule(j).m_pRHS, P::Rule(j).m_nLength, len);
+
+        len.swap(next);
+      } //for
+
+      return Sum(P::Root(), strlen(P::Root()), len);
+    } //GetLength
+
+    /// \brief Generate a string.
+    ///
+    /// The expansion of the left-hand side of each production is built one
+    /// generation at a time from those of the previous generation, up to
+    /// generation n - 1, keeping only two generations of them. Generation n is
+    /// then assembled from these, so the work is mostly copying long strings
+    /// into space reserved for them.
+    /// \param n Number of generations.
+    /// \param s [out] Generation n.
+
+    static void Generate(UINT n, std::string& s){
+      s.clear();
+      s.reserve(GetLength(n));
+
+      if(n == 0)s = P::Root(); //nothing to expand
+
+      else{ //expand the root
+        std::vector<std::string> v(P::NumRules()); //expansions of lhs
+        std::vector<std::string> next(P::NumRules()); //one generation later
+        std::vector<size_t> len(P::NumRules(), 1); //lengths of expansions
+
+        for(size_t j=0; j<P::NumRules(); j++) //zero generations
+          v[j].assign(1, P::Rule(j).m_chLHS);
+
+        for(UINT k=1; k<n; k++){ //for each generation but the last
+          for(size_t j=0; j<P::NumRules(); j++){ //for each production
+            const LPresetRule r = P::Rule(j);
+            next[j].clear();
+            next[j].reserve(Sum(r.m_pRHS, r.m_nLength, len));
+            Append(next[j], r.m_pRHS, r.m_nLength, v);
+          } //for
+
+          v.swap(next);
+
+          for(size_t j=0; j<P::NumRules(); j++)
+            len[j] = v[j].size();
+        } //for
+
+        for(const char* p=P::Root(); *p; p++){ //for each symbol of the root
+          const size_t j = Find(*p); //index of production for *p
+
+          if(j < P::NumRules()) //expand
+            Append(s, P::Rule(j).m_pRHS, P::Rule(j).m_nLength, v);
+          else s.push_back(*p); //constant
+        } //for
+      } //else
+    } //Generate
+}; //LPreset
+
+#pragma endregion LPreset
@@ -43,48 +43,102 @@ CRandom::CRandom(){
 
 /// If the seed is negative (which it is by default if no parameter is 
 /// supplied), then use timeGetTime instead (which is, one hopes, unpredictable).
-/// The state variables for xorshift128 are initialized using the C Standard
-/// Library function rand() seeded using the pro-offered seed value.
+/// The seed is hashed to make the key for stream 0, and the counter is reset.
 /// \param seed The seed, defaults to -1.
 
 void CRandom::srand(int seed){ 
-  ::srand((seed >= 0)? seed: timeGetTime() & 0x7FFF);
+  const UINT s = (seed >= 0)? (UINT)seed: timeGetTime(); //the seed to use
 
-  m_uState[0] = UINT(::rand());
-
-  for(int i=1; i<=3; i++)
-    m_uState[i] = m_uState[i - 1]*UINT(::rand());
+  m_nSeed = Mix(s);
+  SetStream(0);
 } //srand
 
-#pragma endregion Constructor and initialization
+/// Select one of the independent streams of numbers for the current seed,
+/// and reset the counter to its start. Stream 0 is selected by srand().
+/// \param id Stream number.
 
-///////////////////////////////////////////////////////////////////////////////
-// Functions that generate pseudo-random numbers
+void CRandom::SetStream(ULONGLONG id){
+  m_nKey = Mix(m_nSeed + Mix(id));
+  m_nCounter = 0;
+} //SetStream
 
-#pragma region Generate pseudo-random numbers
+/// Skip ahead in the current stream as if randn() had been called a given
+/// number of times, in constant time.
+/// \param n Number of values to skip.
 
-/// Generate a pseudorandom unsigned integer using xorshift128. This is the one
-/// that does the actual work here: The other pseudorandom generation functions
-/// rely on it to do the heavy lifting. Algorithm snarfed from the interwebs
-/// someplace, I don't quite remember where.
-/// \return A pseudorandom unsigned integer.
+void CRandom::Skip(ULONGLONG n){
+  m_nCounter += n;
+} //Skip
 
-UINT CRandom::randn(){ 
-	UINT s = m_uState[3];
+/// Get the position in the current stream.
+/// \return Number of values drawn or skipped since the stream was selected.
 
-	s ^= s << 11;
-	s ^= s >> 8;
+ULONGLONG CRandom::GetCounter() const{
+  return m_nCounter;
+} //GetCounter
 
-	m_uState[3] = m_uState[2]; 
-  m_uState[2] = m_uState[1]; 
-  m_uState[1] = m_uState[0];
+#pragma endregion Constructor and initialization
+
+///////////////////////////////////////////////////////////////////////////////
+// Functions that generate pseudo-random numbers
 
-	s ^= m_uState[0];
-	s ^= m_uState[0] >> 19;	
+#pragma region Generate pseudo-random numbers
 
-	m_uState[0] = s;
+static const ULONGLONG GAMMA = 0x9E3779B97F4A7C15ULL; ///< Golden ratio.
+
+/// The SplitMix64 finalizer, a 64-bit hash whose output bits all depend on
+/// all of the input bits.
+/// \param x A 64-bit value.
+/// \return The hash of x.
+
+ULONGLONG CRandom::Mix(ULONGLONG x){
+  x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+
+  return x;
+} //Mix
+
+/// Get the value at a given position of the current stream, that is, the
+/// value that randn() would give if the counter were at that position,
+/// without changing the counter. This is the one that does the actual
+/// work here: The other pseudorandom generation functions rely on it to do
+/// the heavy lifting. It is SplitMix64 started from the key of the current
+/// stream, that is, value \f$i\f$ is the hash of the key plus \f$i + 1\f$
+/// times the golden ratio, of which the high 32 bits are used. Since it is
+/// a pure function of position, several threads can call it at once.
+/// \param i Position in the stream.
+/// \return The pseudorandom unsigned integer at position i.
+
+UINT CRandom::GetValue(ULONGLONG i) const{
+  return UINT(SubKey(m_nKey, i) >> 32);
+} //GetValue
+
+/// Reader function for the key of the current stream.
+/// \return The key of the current stream.
+
+ULONGLONG CRandom::GetKey() const{
+  return m_nKey;
+} //GetKey
+
+/// Make the key of a child from the key of its parent and its index among
+/// the parent's children. This is the hash that GetValue() takes the high
+/// 32 bits of, so value \f$i\f$ of a stream is the high half of the key of
+/// child \f$i\f$ of the stream's key.
+/// \param key The key of the parent.
+/// \param i Index of the child.
+/// \return The key of child i.
+
+ULONGLONG CRandom::SubKey(ULONGLONG key, ULONGLONG i){
+  return Mix(key + (i + 1)*GAMMA);
+} //SubKey
+
+/// Generate a pseudorandom unsigned integer, the value at the counter, and
+/// advance the counter.
+/// \return A pseudorandom unsigned integer.
 
-	return s;
+UINT CRandom::randn(){
+  return GetValue(m_nCounter++);
 } //randn
 
 /// Generate a pseudorandom unsigned integer within a range.
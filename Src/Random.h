@@ -29,18 +29,45 @@
 
 /// \brief Pseudorandom Number Generator (PRNG for short).
 ///
-/// A simple pseudorandom number generator based on xorshift128. It
-/// can be seeded with the time or, if reproducability is desired (eg. when
-/// debugging), with a fixed seed.
+/// A counter-based pseudorandom number generator. The \f$i\f$th number
+/// of a stream is a hash (the SplitMix64 finalizer) of a key and \f$i\f$,
+/// so the generator's whole state is the key and a counter. It can be
+/// seeded with the time or, if reproducability is desired (eg. when
+/// debugging), with a fixed seed, and gives the same numbers for the same
+/// seed on every platform.
+///
+/// Since the \f$i\f$th number does not depend on the ones before it, a
+/// copy of the generator can skip ahead to any position in constant time,
+/// so that work that draws numbers can be split among threads and still
+/// draw exactly the numbers that one thread would. GetValue() gives the
+/// number at any position directly, without changing the generator.
+/// Independent streams for the same seed are selected by number with
+/// SetStream().
+///
+/// The same hash makes keys for a tree of streams: SubKey() makes the key
+/// of the \f$i\f$th child of any key, so a key can be found for every node
+/// of a tree from the key of the root, which is GetKey() of stream 0, and
+/// the path to the node. LSystem uses this to give every symbol of every
+/// generation its own key.
 
 class CRandom{
   private: 
-    UINT m_uState[4]; ///< Current state.
+    ULONGLONG m_nSeed = 0; ///< Hashed seed.
+    ULONGLONG m_nKey = 0; ///< Key of current stream.
+    ULONGLONG m_nCounter = 0; ///< Number of values drawn from the stream.
+
+    static ULONGLONG Mix(ULONGLONG x); ///< Hash function.
 
   public:
     CRandom(); ///< Constructor.
 
     void srand(int seed=-1); ///< Seed the random number generator.
+    void SetStream(ULONGLONG id); ///< Select a stream.
+    void Skip(ULONGLONG n); ///< Skip ahead.
+    ULONGLONG GetCounter() const; ///< Get number of values drawn.
+    UINT GetValue(ULONGLONG i) const; ///< Get value at position.
+    ULONGLONG GetKey() const; ///< Get key of current stream.
+    static ULONGLONG SubKey(ULONGLONG key, ULONGLONG i); ///< Get key of child.
 
     UINT randn(); ///< Get random unsigned integer.
     UINT randn(UINT i, UINT j); ///< Get random integer in \f$[i,j]\f$.
@@ -0,0 +1,254 @@
+/// \file RenderCache.cpp
+/// \brief Code for the render cache CRenderCache.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "RenderCache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructors and destructors
+
+#pragma region Constructors and destructors
+
+/// \param budget Maximum total size of entries in bytes.
+
+CRenderCache::CRenderCache(size_t budget):
+  m_nBudget(budget){
+} //constructor
+
+/// Delete all cached bitmaps.
+
+CRenderCache::~CRenderCache(){
+  Clear();
+} //destructor
+
+#pragma endregion Constructors and destructors
+
+///////////////////////////////////////////////////////////////////////////////
+// CRenderKey
+
+#pragma region CRenderKey
+
+/// Keys are equal if all of their fields are equal.
+/// \param k A key.
+/// \return true if they are equal.
+
+bool CRenderKey::operator==(const CRenderKey& k) const{
+  return m_nKind == k.m_nKind && m_nRules == k.m_nRules &&
+    m_nGenerations == k.m_nGenerations && m_nSeed == k.m_nSeed &&
+    m_fAngleDelta == k.m_fAngleDelta && m_fLength == k.m_fLength &&
+    m_fLenMultiplier == k.m_fLenMultiplier && m_fPointSize == k.m_fPointSize &&
+    m_bParallel == k.m_bParallel;
+} //operator==
+
+/// Hash the fields one at a time, so that padding is not hashed.
+/// \return A 64-bit hash.
+
+ULONGLONG CRenderKey::GetHash() const{
+  ULONGLONG h = HashBytes(&m_nKind, sizeof(m_nKind));
+  h = HashBytes(&m_nRules, sizeof(m_nRules), h);
+  h = HashBytes(&m_nGenerations, sizeof(m_nGenerations), h);
+  h = HashBytes(&m_nSeed, sizeof(m_nSeed), h);
+  h = HashBytes(&m_fAngleDelta, sizeof(m_fAngleDelta), h);
+  h = HashBytes(&m_fLength, sizeof(m_fLength), h);
+  h = HashBytes(&m_fLenMultiplier, sizeof(m_fLenMultiplier), h);
+  h = HashBytes(&m_fPointSize, sizeof(m_fPointSize), h);
+  h = HashBytes(&m_bParallel, sizeof(m_bParallel), h);
+
+  return h;
+} //GetHash
+
+#pragma endregion CRenderKey
+
+///////////////////////////////////////////////////////////////////////////////
+// Private helper functions
+
+#pragma region Private helper functions
+
+/// Find an entry and move it to the front of the list, since it is now the
+/// most recently used. The entry is found by the hash of the key, and is
+/// only a hit if its whole key is equal to the one given.
+/// \param key Key.
+/// \return Pointer to the entry, nullptr if there is none.
+
+CRenderEntry* CRenderCache::Find(const CRenderKey& key){
+  auto p = m_mapIndex.find(key.GetHash());
+  if(p == m_mapIndex.end() || !(p->second->m_cKey == key))return nullptr; //miss
+
+  m_listEntries.splice(m_listEntries.begin(), m_listEntries, p->second);
+  return &m_listEntries.front();
+} //Find
+
+/// Insert a new empty entry at the front of the list, replacing any old entry
+/// with the same hash, then discard least recently used entries until the
+/// total size is within budget. The new entry itself is never discarded, so
+/// the caller must check that it fits the budget.
+/// \param key Key.
+/// \param bytes Size of the new entry in bytes.
+/// \return Reference to the new entry.
+
+CRenderEntry& CRenderCache::Insert(const CRenderKey& key, size_t bytes){
+  const ULONGLONG h = key.GetHash(); //hash of key
+
+  auto p = m_mapIndex.find(h);
+  if(p != m_mapIndex.end())Erase(p->second); //replace old entry
+
+  while(!m_listEntries.empty() && m_nBytes + bytes > m_nBudget)
+    Erase(std::prev(m_listEntries.end())); //discard least recently used
+
+  m_listEntries.push_front(CRenderEntry());
+  CRenderEntry& e = m_listEntries.front(); //the new entry
+  e.m_cKey = key;
+  e.m_nBytes = bytes;
+
+  m_mapIndex[h] = m_listEntries.begin();
+  m_nBytes += bytes;
+
+  return e;
+} //Insert
+
+/// Erase an entry, deleting its bitmap if it has one.
+/// \param p Iterator for entry in list.
+
+void CRenderCache::Erase(std::list<CRenderEntry>::iterator p){
+  m_nBytes -= p->m_nBytes;
+  m_mapIndex.erase(p->m_cKey.GetHash());
+  delete p->m_pBitmap;
+  m_listEntries.erase(p);
+} //Erase
+
+#pragma endregion Private helper functions
+
+///////////////////////////////////////////////////////////////////////////////
+// Strings
+
+#pragma region Strings
+
+/// Find a cached string.
+/// \param key Key.
+/// \return Pointer to the cached string, nullptr if there is none. The
+/// pointer is valid until the cache is next changed.
+
+const std::string* CRenderCache::FindString(const CRenderKey& key){
+  CRenderEntry* p = Find(key);
+  return p? &p->m_strString: nullptr;
+} //FindString
+
+/// Insert a copy of a string, unless it is larger than the whole budget.
+/// \param key Key.
+/// \param s String.
+
+void CRenderCache::InsertString(const CRenderKey& key, const std::string& s){
+  const size_t bytes = s.size(); //size of string
+  if(bytes > m_nBudget)return; //too large to cache
+
+  Insert(key, bytes).m_strString = s;
+} //InsertString
+
+#pragma endregion Strings
+
+///////////////////////////////////////////////////////////////////////////////
+// Geometry
+
+#pragma region Geometry
+
+/// Find cached turtle geometry.
+/// \param key Key.
+/// \return Pointer to the cached geometry, nullptr if there is none. The
+/// pointer is valid until the cache is next changed.
+
+const CRenderGeometry* CRenderCache::FindGeometry(const CRenderKey& key){
+  CRenderEntry* p = Find(key);
+  return p? &p->m_cGeometry: nullptr;
+} //FindGeometry
+
+/// Insert a copy of turtle geometry, unless it is larger than the whole
+/// budget. Its size is that of the segment arrays.
+/// \param key Key.
+/// \param s Segments.
+/// \param left Smallest x coordinate.
+/// \param top Smallest y coordinate.
+/// \param right Largest x coordinate.
+/// \param bottom Largest y coordinate.
+
+void CRenderCache::InsertGeometry(const CRenderKey& key, const CSegments& s,
+  float left, float top, float right, float bottom)
+{
+  const size_t bytes = s.GetSize()*(4*sizeof(float) + sizeof(unsigned) +
+    sizeof(unsigned long long)) + s.m_vA0.size()*4*sizeof(long long); //size of arrays
+
+  if(bytes > m_nBudget)return; //too large to cache
+
+  CRenderGeometry& g = Insert(key, bytes).m_cGeometry; //the new geometry
+  g.m_cSegments = s;
+  g.m_fLeft = left;
+  g.m_fTop = top;
+  g.m_fRight = right;
+  g.m_fBottom = bottom;
+} //InsertGeometry
+
+#pragma endregion Geometry
+
+///////////////////////////////////////////////////////////////////////////////
+// Bitmaps
+
+#pragma region Bitmaps
+
+/// Find a cached bitmap.
+/// \param key Key.
+/// \return Pointer to the cached bitmap, nullptr if there is none. The
+/// bitmap belongs to the cache, so the caller should clone it rather than
+/// keep the pointer.
+
+Gdiplus::Bitmap* CRenderCache::FindBitmap(const CRenderKey& key){
+  CRenderEntry* p = Find(key);
+  return p? p->m_pBitmap: nullptr;
+} //FindBitmap
+
+/// Insert a clone of a bitmap, unless it is larger than the whole budget.
+/// Its size is taken to be 4 bytes per pixel.
+/// \param key Key.
+/// \param pBitmap Pointer to a bitmap, which still belongs to the caller.
+
+void CRenderCache::InsertBitmap(const CRenderKey& key, Gdiplus::Bitmap* pBitmap){
+  const UINT w = pBitmap->GetWidth(); //width
+  const UINT h = pBitmap->GetHeight(); //height
+  const size_t bytes = (size_t)w*h*4; //size of bitmap
+
+  if(bytes > m_nBudget)return; //too large to cache
+
+  Insert(key, bytes).m_pBitmap =
+    pBitmap->Clone(0, 0, w, h, PixelFormat32bppARGB);
+} //InsertBitmap
+
+#pragma endregion Bitmaps
+
+///////////////////////////////////////////////////////////////////////////////
+// Clear
+
+/// Discard all entries and delete their bitmaps.
+
+void CRenderCache::Clear(){
+  while(!m_listEntries.empty())
+    Erase(m_listEntries.begin());
+} //Clear
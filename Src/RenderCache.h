@@ -0,0 +1,131 @@
+/// \file RenderCache.h
+/// \brief Interface for the render cache CRenderCache.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#pragma once
+
+#include "Includes.h"
+#include "Types.h"
+
+#define RENDER_STRING 0 ///< Kind of cache entry holding a generated string.
+#define RENDER_GEOMETRY 1 ///< Kind of cache entry holding turtle geometry.
+#define RENDER_BITMAP 2 ///< Kind of cache entry holding a bitmap.
+
+/// \brief Render cache key.
+///
+/// Everything that affects a cached object. A generated string depends on
+/// the root and rules, the number of generations, and the seed, turtle
+/// geometry also on the turtle graphics settings other than the line width
+/// and on whether the turtle read in parallel, which changes the floating
+/// point rounding (see CTurtle::SetThreads()), and a bitmap on the line
+/// width too. Fields that do not affect an object
+/// are left at zero. The fields are stored in the cache with the object and
+/// compared on every lookup, so a collision of the 64-bit hash used to
+/// index the cache is a miss rather than the wrong object. The root and
+/// rules are only stored as a hash, see LSystem::GetHash().
+
+class CRenderKey{
+  public:
+    UINT m_nKind = RENDER_STRING; ///< Kind of object, `RENDER_STRING` etc.
+    ULONGLONG m_nRules = 0; ///< Hash of root and rules.
+    UINT m_nGenerations = 0; ///< Number of generations.
+    int m_nSeed = 0; ///< Seed, if stochastic.
+    float m_fAngleDelta = 0; ///< Turtle angle delta.
+    float m_fLength = 0; ///< Turtle line length.
+    float m_fLenMultiplier = 0; ///< Turtle line length multiplier.
+    float m_fPointSize = 0; ///< Line width.
+    bool m_bParallel = false; ///< Whether the turtle read in parallel.
+
+    bool operator==(const CRenderKey& k) const; ///< Equality.
+    ULONGLONG GetHash() const; ///< Hash of the fields.
+}; //CRenderKey
+
+/// \brief Turtle geometry.
+///
+/// The segments that the turtle drew and their exact bounding box.
+
+class CRenderGeometry{
+  public:
+    CSegments m_cSegments; ///< Segments.
+    float m_fLeft = 0; ///< Smallest x coordinate.
+    float m_fTop = 0; ///< Smallest y coordinate.
+    float m_fRight = 0; ///< Largest x coordinate.
+    float m_fBottom = 0; ///< Largest y coordinate.
+}; //CRenderGeometry
+
+/// \brief Render cache entry.
+///
+/// A generated string, turtle geometry, or a finished bitmap, stored with its
+/// key. Only one of the three is used in any entry.
+
+class CRenderEntry{
+  public:
+    CRenderKey m_cKey; ///< Key.
+    std::string m_strString; ///< Generated string.
+    CRenderGeometry m_cGeometry; ///< Turtle geometry.
+    Gdiplus::Bitmap* m_pBitmap = nullptr; ///< Bitmap, owned by the cache.
+    size_t m_nBytes = 0; ///< Approximate size in bytes.
+}; //CRenderEntry
+
+/// \brief Render cache.
+///
+/// A least-recently-used cache of generated strings, turtle geometry, and
+/// finished bitmaps, so that going back to an L-system that has already been
+/// drawn does not mean generating and drawing it again, and drawing the same
+/// string with a different line width does not mean running the turtle
+/// again. Entries are kept in a list from most to least recently used, with
+/// a hash map from the hashes of their keys to list positions. A lookup
+/// compares the whole key, not just its hash. When the total size of the
+/// entries exceeds the budget, entries are discarded from the least
+/// recently used end. The caller is responsible for making keys that
+/// include everything that affects the cached object (see CRenderKey).
+
+class CRenderCache{
+  private:
+    std::list<CRenderEntry> m_listEntries; ///< Entries, most recent first.
+    std::unordered_map<ULONGLONG, std::list<CRenderEntry>::iterator> m_mapIndex; ///< Index.
+
+    size_t m_nBytes = 0; ///< Total size of entries.
+    size_t m_nBudget = 0; ///< Maximum total size of entries.
+
+    CRenderEntry* Find(const CRenderKey& key); ///< Find entry and make it most recent.
+    CRenderEntry& Insert(const CRenderKey& key, size_t bytes); ///< Insert entry.
+    void Erase(std::list<CRenderEntry>::iterator p); ///< Erase entry.
+
+  public:
+    CRenderCache(size_t budget); ///< Constructor.
+    ~CRenderCache(); ///< Destructor.
+
+    const std::string* FindString(const CRenderKey& key); ///< Find string.
+    void InsertString(const CRenderKey& key, const std::string& s); ///< Insert string.
+
+    const CRenderGeometry* FindGeometry(const CRenderKey& key); ///< Find geometry.
+    void InsertGeometry(const CRenderKey& key, const CSegments& s,
+      float left, float top, float right, float bottom); ///< Insert geometry.
+
+    Gdiplus::Bitmap* FindBitmap(const CRenderKey& key); ///< Find bitmap.
+    void InsertBitmap(const CRenderKey& key, Gdiplus::Bitmap* pBitmap); ///< Insert bitmap.
+
+    void Clear(); ///< Discard all entries.
+}; //CRenderCache
@@ -0,0 +1,136 @@
+/// \file RingBuffer.h
+/// \brief Interface and code for the ring buffer CRingBuffer.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#pragma once
+
+#include "Includes.h"
+
+/// \brief Single-producer single-consumer ring buffer.
+///
+/// A bounded lock-free queue for passing data from one thread (the producer)
+/// to another (the consumer). Each index is written by only one of the
+/// threads, so two atomic indices are all the synchronization that is needed.
+/// The producer calls Push() and finally Close(); the consumer calls Pop()
+/// until it returns 0. Both wait, yielding their time slice, when the ring is
+/// full or empty respectively. Data is copied in bulk to keep the number of
+/// atomic operations per element small.
+/// \tparam T Element type.
+
+template<class T> class CRingBuffer{
+  private:
+    std::vector<T> m_vBuffer; ///< Storage, size is a power of 2.
+    size_t m_nMask = 0; ///< Size of storage minus 1.
+
+    std::atomic<size_t> m_nHead; ///< Count of elements popped.
+    std::atomic<size_t> m_nTail; ///< Count of elements pushed.
+    std::atomic<bool> m_bClosed; ///< Producer has finished.
+
+  public:
+    CRingBuffer(size_t n); ///< Constructor.
+
+    void Push(const T* p, size_t n); ///< Push elements.
+    size_t Pop(T* p, size_t n); ///< Pop elements.
+    void Close(); ///< Signal end of data.
+}; //CRingBuffer
+
+/// The capacity is rounded up to a power of 2 so that indices can be reduced
+/// with a mask instead of a division.
+/// \param n Minimum capacity, in elements.
+
+template<class T> CRingBuffer<T>::CRingBuffer(size_t n):
+  m_nHead(0), m_nTail(0), m_bClosed(false)
+{
+  size_t size = 1; //capacity
+  while(size < n)size <<= 1;
+
+  m_vBuffer.resize(size);
+  m_nMask = size - 1;
+} //constructor
+
+/// Push elements onto the ring, waiting for the consumer to make room if
+/// necessary. Only the producer may call this.
+/// \param p Pointer to elements.
+/// \param n Number of elements.
+
+template<class T> void CRingBuffer<T>::Push(const T* p, size_t n){
+  const size_t size = m_nMask + 1; //capacity
+  size_t tail = m_nTail.load(std::memory_order_relaxed); //only we write it
+
+  while(n > 0){
+    const size_t head = m_nHead.load(std::memory_order_acquire);
+    const size_t room = size - (tail - head); //free space
+
+    if(room == 0){ //full
+      std::this_thread::yield();
+      continue;
+    } //if
+
+    const size_t count = min(n, room); //number to copy this time
+
+    for(size_t i=0; i<count; i++)
+      m_vBuffer[(tail + i) & m_nMask] = p[i];
+
+    tail += count;
+    m_nTail.store(tail, std::memory_order_release); //publish
+    p += count;
+    n -= count;
+  } //while
+} //Push
+
+/// Pop elements from the ring, waiting for the producer if the ring is
+/// empty. Only the consumer may call this.
+/// \param p [out] Pointer to space for elements.
+/// \param n Maximum number of elements to pop.
+/// \return Number of elements popped, which is 0 only after the producer
+/// has closed the ring and it is empty.
+
+template<class T> size_t CRingBuffer<T>::Pop(T* p, size_t n){
+  size_t head = m_nHead.load(std::memory_order_relaxed); //only we write it
+
+  while(true){
+    const bool bClosed = m_bClosed.load(std::memory_order_acquire);
+    const size_t tail = m_nTail.load(std::memory_order_acquire);
+
+    if(tail != head){ //not empty
+      const size_t count = min(n, tail - head); //number to copy
+
+      for(size_t i=0; i<count; i++)
+        p[i] = m_vBuffer[(head + i) & m_nMask];
+
+      m_nHead.store(head + count, std::memory_order_release); //free space
+      return count;
+    } //if
+
+    if(bClosed)return 0; //empty and nothing more is coming
+    std::this_thread::yield();
+  } //while
+} //Pop
+
+/// Signal that the producer will not push any more elements. Only the
+/// producer may call this, after its last Push().
+
+template<class T> void CRingBuffer<T>::Close(){
+  m_bClosed.store(true, std::memory_order_release);
+} //Close
@@ -0,0 +1,198 @@
+/// \file SpillFile.cpp
+/// \brief Code for the spill file CSpillFile.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "SpillFile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Open and close
+
+#pragma region Open and close
+
+/// Close the file, which deletes it.
+
+CSpillFile::~CSpillFile(){
+  Close();
+} //destructor
+
+/// Create a new empty file in the temporary folder, closing any file that
+/// is already open. The file is opened for sequential access and marked as
+/// temporary, so that the operating system keeps as much of it in its cache
+/// as it can and deletes it when it is closed.
+/// \return true if the file was created.
+
+bool CSpillFile::Open(){
+  Close();
+
+  WCHAR path[MAX_PATH]; //temporary folder
+  WCHAR name[MAX_PATH]; //file name
+
+  if(GetTempPathW(MAX_PATH, path) == 0 ||
+    GetTempFileNameW(path, L"lsy", 0, name) == 0)
+  {
+    m_bFailed = true;
+    return false;
+  } //if
+
+  m_hFile = CreateFileW(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+    CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE |
+    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+  m_bFailed = m_hFile == INVALID_HANDLE_VALUE;
+  if(m_bFailed)DeleteFileW(name); //made by GetTempFileNameW()
+  else m_vBuffer.reserve(SPILL_BUFFER);
+
+  return !m_bFailed;
+} //Open
+
+/// Close the file, if one is open, discarding anything still buffered. The
+/// file is deleted by the operating system.
+
+void CSpillFile::Close(){
+  if(m_hFile != INVALID_HANDLE_VALUE)
+    CloseHandle(m_hFile);
+
+  m_hFile = INVALID_HANDLE_VALUE;
+  m_nSize = 0;
+  m_bFailed = false;
+  m_vBuffer.clear();
+  m_vBuffer.shrink_to_fit();
+} //Close
+
+#pragma endregion Open and close
+
+///////////////////////////////////////////////////////////////////////////////
+// Read and write
+
+#pragma region Read and write
+
+/// Append bytes to the file. They are copied to a buffer, which is written
+/// to the file when it is full. Blocks of at least a buffer's worth are
+/// written directly.
+/// \param p Pointer to the bytes.
+/// \param n Number of bytes.
+
+void CSpillFile::Write(const char* p, size_t n){
+  if(m_vBuffer.size() + n > SPILL_BUFFER) //no room
+    Flush();
+
+  if(n >= SPILL_BUFFER){ //too large to buffer
+    for(size_t i=0; i<n && !m_bFailed; ){ //in pieces that fit in a DWORD
+      const DWORD k = (DWORD)min(n - i, (size_t)SPILL_BUFFER); //piece size
+      DWORD written = 0; //number of bytes written
+
+      if(!WriteFile(m_hFile, p + i, k, &written, nullptr) || written != k)
+        m_bFailed = true;
+
+      i += k;
+    } //for
+  } //if
+
+  else m_vBuffer.insert(m_vBuffer.end(), p, p + n);
+
+  m_nSize += n;
+} //Write
+
+/// Write the buffered bytes to the file.
+
+void CSpillFile::Flush(){
+  if(m_vBuffer.empty())return; //nothing to do
+
+  const DWORD k = (DWORD)m_vBuffer.size(); //number of bytes to write
+  DWORD written = 0; //number of bytes written
+
+  if(m_bFailed || !WriteFile(m_hFile, m_vBuffer.data(), k, &written, nullptr) ||
+    written != k)
+    m_bFailed = true;
+
+  m_vBuffer.clear();
+} //Flush
+
+/// Read the whole file in order, a window at a time. The buffer is flushed
+/// first. Each window is mapped into memory, passed to a function, and
+/// unmapped, so the function must not keep the pointer. The windows start
+/// at multiples of `SPILL_WINDOW`, which must be a multiple of the
+/// allocation granularity of the operating system (64KB on Windows).
+/// \param f Function to call for each window, which takes a pointer to the
+/// bytes, the number of bytes, and the offset of the window in the file.
+
+void CSpillFile::Read(const std::function<void(const char*, size_t, ULONGLONG)>& f){
+  Flush();
+  if(m_nSize == 0 || m_bFailed)return; //nothing to read
+
+  const HANDLE hMap = CreateFileMappingW(m_hFile, nullptr, PAGE_READONLY,
+    0, 0, nullptr); //mapping of the whole file
+
+  if(hMap == nullptr){ //mapping failed
+    m_bFailed = true;
+    return;
+  } //if
+
+  for(ULONGLONG pos=0; pos<m_nSize; pos+=SPILL_WINDOW){ //for each window
+    const size_t n = (size_t)min(m_nSize - pos, (ULONGLONG)SPILL_WINDOW); //size
+    const char* p = (const char*)MapViewOfFile(hMap, FILE_MAP_READ,
+      (DWORD)(pos >> 32), (DWORD)pos, n); //mapped window
+
+    if(p == nullptr){ //mapping failed
+      m_bFailed = true;
+      break;
+    } //if
+
+    f(p, n, pos);
+    UnmapViewOfFile(p);
+  } //for
+
+  CloseHandle(hMap);
+} //Read
+
+#pragma endregion Read and write
+
+///////////////////////////////////////////////////////////////////////////////
+// Reader functions
+
+#pragma region Reader functions
+
+/// Reader function for whether a file is open.
+/// \return true if a file is open.
+
+bool CSpillFile::IsOpen() const{
+  return m_hFile != INVALID_HANDLE_VALUE;
+} //IsOpen
+
+/// Reader function for the error flag.
+/// \return true if a read or write has failed since the file was opened.
+
+bool CSpillFile::IsFailed() const{
+  return m_bFailed;
+} //IsFailed
+
+/// Reader function for the size, which includes any buffered bytes.
+/// \return Number of bytes written.
+
+ULONGLONG CSpillFile::GetSize() const{
+  return m_nSize;
+} //GetSize
+
+#pragma endregion Reader functions
@@ -0,0 +1,71 @@
+/// \file SpillFile.h
+/// \brief Interface for the spill file CSpillFile.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#pragma once
+
+#include "Includes.h"
+
+#define SPILL_WINDOW (1 << 26) ///< Bytes mapped at a time when reading.
+#define SPILL_BUFFER (1 << 20) ///< Bytes buffered at a time when writing.
+
+/// \brief Spill file.
+///
+/// A temporary file for strings that are too long to keep in memory. It is
+/// written sequentially by appending, a buffer at a time, and read
+/// sequentially by mapping it into memory a window of `SPILL_WINDOW` bytes at
+/// a time, so that only a window and a buffer are ever in memory no matter
+/// how long the string is. The file is created in the temporary folder and
+/// is deleted by the operating system when it is closed, even if the program
+/// does not get to close it.
+///
+/// Errors, such as the disk filling up, are recorded rather than reported
+/// straight away, so that the writer can check once at the end with
+/// IsFailed() instead of after every write.
+
+class CSpillFile{
+  private:
+    HANDLE m_hFile = INVALID_HANDLE_VALUE; ///< File handle.
+    ULONGLONG m_nSize = 0; ///< Number of bytes written.
+    std::vector<char> m_vBuffer; ///< Bytes waiting to be written.
+    bool m_bFailed = false; ///< Whether an error has occurred.
+
+  public:
+    CSpillFile() = default; ///< Default constructor.
+    CSpillFile(const CSpillFile&) = delete; ///< No copy constructor.
+    CSpillFile& operator=(const CSpillFile&) = delete; ///< No assignment.
+    ~CSpillFile(); ///< Destructor.
+
+    bool Open(); ///< Create an empty file.
+    void Close(); ///< Close and delete the file.
+
+    void Write(const char* p, size_t n); ///< Append bytes.
+    void Flush(); ///< Write buffered bytes to the file.
+    void Read(const std::function<void(const char*, size_t, ULONGLONG)>& f); ///< Read in windows.
+
+    bool IsOpen() const; ///< Is a file open.
+    bool IsFailed() const; ///< Has an error occurred.
+    ULONGLONG GetSize() const; ///< Get size in bytes.
+}; //CSpillFile
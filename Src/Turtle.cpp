@@ -0,0 +1,669 @@
+/// \file Turtle.cpp
+/// \brief Code for the turtle graphics interpreter CTurtle.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "Turtle.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CSegments
+
+#pragma region CSegments
+
+/// Reader function for the number of segments.
+/// \return Number of segments.
+
+size_t CSegments::GetSize() const{
+  return m_vX0.size();
+} //GetSize
+
+/// Remove all segments, keeping the memory for reuse.
+
+void CSegments::Clear(){
+  m_vX0.clear(); m_vY0.clear();
+  m_vX1.clear(); m_vY1.clear();
+  m_vDepth.clear();
+  m_vIndex.clear();
+  m_vA0.clear(); m_vB0.clear();
+  m_vA1.clear(); m_vB1.clear();
+} //Clear
+
+/// Reserve space in every array, for example for the number of segments
+/// counted by LGrowth::GetExactSegments(), or for a stochastic L-system
+/// predicted by LGrowth::GetSegments().
+/// \param n Number of segments.
+/// \param bLattice true to reserve the lattice arrays too.
+
+void CSegments::Reserve(size_t n, bool bLattice){
+  m_vX0.reserve(n); m_vY0.reserve(n);
+  m_vX1.reserve(n); m_vY1.reserve(n);
+  m_vDepth.reserve(n);
+  m_vIndex.reserve(n);
+
+  if(bLattice){
+    m_vA0.reserve(n); m_vB0.reserve(n);
+    m_vA1.reserve(n); m_vB1.reserve(n);
+  } //if
+} //Reserve
+
+#pragma endregion CSegments
+
+///////////////////////////////////////////////////////////////////////////////
+// CTurtle
+
+#pragma region CTurtle
+
+/// \brief Default action table.
+///
+/// The action of every symbol, made at compile time from TurtleAction(),
+/// for turtles whose descriptor does not point to one.
+
+class CTurtleActions{
+  public:
+    unsigned char m_nAction[256] = {0}; ///< Action of each symbol.
+
+    /// \brief Constructor.
+
+    constexpr CTurtleActions(){
+      for(unsigned c=0; c<256; c++)
+        m_nAction[c] = TurtleAction((char)c);
+    } //constructor
+}; //CTurtleActions
+
+static constexpr CTurtleActions g_cActions; ///< Default action table.
+
+/// Make the direction table if the angle delta divides a full circle into
+/// no more than `TURTLE_HEADINGS_MAX` turns. The angle delta is a float, so
+/// the number of turns is allowed to be a little off a whole number. The
+/// table has the exact sines and cosines of multiples of the whole circle
+/// divided by that number, not of multiples of the angle delta. If the
+/// descriptor has a baked table with the same number of headings then it is
+/// copied instead of computed, and likewise its action table is used if it
+/// has one.
+/// \param d Turtle graphics descriptor.
+
+CTurtle::CTurtle(const TurtleDesc& d):
+  m_cDesc(d), m_pAction(d.m_pAction? d.m_pAction: g_cActions.m_nAction)
+{
+  const double delta = std::fabs((double)d.m_fAngleDelta); //size of a turn
+
+  if(delta > 0){
+    const double k = 2*TURTLE_PI/delta; //number of turns in a circle
+    const double n = std::floor(k + 0.5); //nearest whole number
+
+    if(n <= TURTLE_HEADINGS_MAX && std::fabs(k - n) < 1e-5*n){ //make table
+      m_nHeadings = (unsigned)n;
+      m_nTurn = (d.m_fAngleDelta > 0)? 1: m_nHeadings - 1;
+
+      if(d.m_pSin && d.m_pCos && d.m_nHeadings == m_nHeadings){ //baked
+        m_vSin.assign(d.m_pSin, d.m_pSin + m_nHeadings);
+        m_vCos.assign(d.m_pCos, d.m_pCos + m_nHeadings);
+      } //if
+
+      else{ //compute
+        m_vSin.resize(m_nHeadings);
+        m_vCos.resize(m_nHeadings);
+
+        for(unsigned j=0; j<m_nHeadings; j++){
+          const double a = 2*TURTLE_PI*j/m_nHeadings; //angle of heading j
+          m_vSin[j] = (float)std::sin(a);
+          m_vCos[j] = (float)std::cos(a);
+        } //for
+      } //else
+
+      MakeLattice();
+    } //if
+  } //if
+
+  Reset();
+} //constructor
+
+/// If the length multiplier is 1 and there is a direction table, try to
+/// write every heading as a whole combination of two basis vectors. The
+/// first is heading 0 and the second is heading 1, or a right angle to
+/// heading 0 if there are fewer than 3 headings. Each heading is solved
+/// for in floating point and rounded, and the turtle is on a lattice only
+/// if every solution rounds to itself. The second basis vector turned by
+/// each heading is solved for in the same way, so that Compose() can turn
+/// lattice coordinates.
+
+void CTurtle::MakeLattice(){
+  if(m_cDesc.m_fLenMultiplier != 1 || m_nHeadings == 0)return;
+
+  const double len = m_cDesc.m_fLength; //length of a step
+  const double a = (m_nHeadings >= 3)? 2*TURTLE_PI/m_nHeadings: TURTLE_PI/2; //angle of V
+
+  m_fUX = 0;                m_fUY = -len;
+  m_fVX = len*std::sin(a);  m_fVY = -len*std::cos(a);
+
+  const double det = m_fUX*m_fVY - m_fUY*m_fVX; //determinant of basis
+
+  //solve for a vector in the basis, returning false if it is not on the lattice
+
+  auto Solve = [&](double dx, double dy, int& a, int& b){
+    const double u = (dx*m_fVY - dy*m_fVX)/det; //Cramer's rule
+    const double v = (m_fUX*dy - m_fUY*dx)/det;
+
+    const double ru = std::floor(u + 0.5); //nearest whole numbers
+    const double rv = std::floor(v + 0.5);
+
+    a = (int)ru;
+    b = (int)rv;
+
+    return std::fabs(u - ru) <= 1e-9 && std::fabs(v - rv) <= 1e-9;
+  }; //Solve
+
+  m_vStepA.resize(m_nHeadings); m_vStepB.resize(m_nHeadings);
+  m_vRotA.resize(m_nHeadings); m_vRotB.resize(m_nHeadings);
+
+  for(unsigned j=0; j<m_nHeadings; j++){ //solve for each heading
+    const double c = std::cos(2*TURTLE_PI*j/m_nHeadings); //turn by heading j
+    const double s = std::sin(2*TURTLE_PI*j/m_nHeadings);
+
+    if(!Solve(len*s, -len*c, m_vStepA[j], m_vStepB[j]) || //step
+      !Solve(m_fVX*c - m_fVY*s, m_fVX*s + m_fVY*c, m_vRotA[j], m_vRotB[j])) //turned V
+    { //not a lattice
+      m_vStepA.clear(); m_vStepB.clear();
+      m_vRotA.clear(); m_vRotB.clear();
+      return;
+    } //if
+  } //for
+
+  m_bLattice = true;
+} //MakeLattice
+
+/// Put the turtle back at the start, facing up with the initial line
+/// length, with an empty stack, no segments, and bounds that contain only
+/// the start point. The index of the next symbol is reset to zero.
+/// \param x Start x coordinate.
+/// \param y Start y coordinate.
+
+void CTurtle::Reset(float x, float y){
+  m_cState = Frame();
+  m_cState.m_fX = x;
+  m_cState.m_fY = y;
+  m_cState.m_fLength = m_cDesc.m_fLength;
+
+  m_fStartX = x;
+  m_fStartY = y;
+
+  m_vStack.clear();
+  m_nDepthBase = 0;
+  m_nIndex = 0;
+  m_cSegments.Clear();
+
+  m_fLeft = m_fRight = x;
+  m_fTop = m_fBottom = y;
+} //Reset
+
+/// Turn the recording of segments on or off. The bounds are kept either way.
+/// \param b true to record segments.
+
+void CTurtle::SetRecord(bool b){
+  m_bRecord = b;
+} //SetRecord
+
+/// Reserve space for segments, so that the buffer is not reallocated while
+/// the turtle reads. LGrowth can predict how many there will be.
+/// \param n Number of segments.
+
+void CTurtle::Reserve(size_t n){
+  m_cSegments.Reserve(n, m_bLattice && m_bRecordLattice);
+} //Reserve
+
+/// Turn the recording of lattice coordinates on or off. They are recorded
+/// only if the turtle is on a lattice and segments are being recorded.
+/// \param b true to record lattice coordinates.
+
+void CTurtle::SetRecordLattice(bool b){
+  m_bRecordLattice = b;
+} //SetRecordLattice
+
+/// Set the number of threads that Read() uses for pieces of at least
+/// `TURTLE_PARALLEL_MIN` symbols. The result does not depend on it, except
+/// for floating point rounding when the turtle is not on a lattice, and
+/// that is the same for any number of threads greater than 1 (see
+/// ReadParallel()).
+/// \param n Number of threads, 0 or 1 to read on the calling thread only.
+
+void CTurtle::SetThreads(unsigned n){
+  m_nThreads = (n > 1)? n: 1;
+} //SetThreads
+
+/// Read one symbol and carry out its command, which is looked up in the
+/// action table.
+/// \param c A symbol.
+
+void CTurtle::Read(char c){
+  Frame& s = m_cState; //shorthand
+
+  switch(m_pAction[(unsigned char)c]){ 
+    case TURTLE_DRAW: { //draw a segment
+      float x, y; //end point
+
+      if(m_bLattice){ //step on the lattice, then convert
+        const long long a = s.m_nA + m_vStepA[s.m_nHeading]; //lattice end point
+        const long long b = s.m_nB + m_vStepB[s.m_nHeading];
+
+        x = float(m_fStartX + a*m_fUX + b*m_fVX);
+        y = float(m_fStartY + a*m_fUY + b*m_fVY);
+
+        if(m_bRecord && m_bRecordLattice){
+          m_cSegments.m_vA0.push_back(s.m_nA);
+          m_cSegments.m_vB0.push_back(s.m_nB);
+          m_cSegments.m_vA1.push_back(a);
+          m_cSegments.m_vB1.push_back(b);
+        } //if
+
+        s.m_nA = a;
+        s.m_nB = b;
+      } //if
+
+      else if(m_nHeadings > 0){ //look up the direction
+        x = s.m_fX + s.m_fLength*m_vSin[s.m_nHeading];
+        y = s.m_fY - s.m_fLength*m_vCos[s.m_nHeading];
+      } //else if
+
+      else{ //compute the direction
+        x = s.m_fX + s.m_fLength*sinf(s.m_fAngle);
+        y = s.m_fY - s.m_fLength*cosf(s.m_fAngle);
+      } //else
+
+      if(m_bRecord){
+        m_cSegments.m_vX0.push_back(s.m_fX);
+        m_cSegments.m_vY0.push_back(s.m_fY);
+        m_cSegments.m_vX1.push_back(x);
+        m_cSegments.m_vY1.push_back(y);
+        m_cSegments.m_vDepth.push_back(unsigned(m_nDepthBase + m_vStack.size()));
+        m_cSegments.m_vIndex.push_back(m_nIndex);
+      } //if
+
+      if(x < m_fLeft)m_fLeft = x; //extend bounds
+      if(x > m_fRight)m_fRight = x;
+      if(y < m_fTop)m_fTop = y;
+      if(y > m_fBottom)m_fBottom = y;
+
+      s.m_fX = x;
+      s.m_fY = y;
+    } //case
+    break; 
+
+    case TURTLE_LEFT:
+      if(m_nHeadings > 0){ //index goes down by m_nTurn
+        s.m_nHeading += m_nHeadings - m_nTurn;
+        if(s.m_nHeading >= m_nHeadings)s.m_nHeading -= m_nHeadings;
+      } //if
+
+      else s.m_fAngle -= m_cDesc.m_fAngleDelta;
+    break;
+
+    case TURTLE_RIGHT:
+      if(m_nHeadings > 0){ //index goes up by m_nTurn
+        s.m_nHeading += m_nTurn;
+        if(s.m_nHeading >= m_nHeadings)s.m_nHeading -= m_nHeadings;
+      } //if
+
+      else s.m_fAngle += m_cDesc.m_fAngleDelta;
+    break;
+
+    case TURTLE_PUSH: 
+      m_vStack.push_back(s); 
+      s.m_fLength *= m_cDesc.m_fLenMultiplier;
+    break;
+
+    case TURTLE_POP:
+      if(!m_vStack.empty()){ //ignore if unmatched
+        s = m_vStack.back();
+        m_vStack.pop_back();
+      } //if
+    break;
+  } //switch
+
+  m_nIndex++;
+} //Read
+
+/// Read symbols and carry out their commands. Pieces of at least
+/// `TURTLE_PARALLEL_MIN` symbols are read by ReadParallel() if there is
+/// more than one thread.
+/// \param p Pointer to the symbols.
+/// \param n Number of symbols.
+
+void CTurtle::Read(const char* p, size_t n){
+  if(m_nThreads > 1 && n >= TURTLE_PARALLEL_MIN)
+    ReadParallel(p, n);
+
+  else for(size_t i=0; i<n; i++)
+    Read(p[i]);
+} //Read
+
+#pragma endregion CTurtle
+
+///////////////////////////////////////////////////////////////////////////////
+// Parallel reading
+
+#pragma region Parallel reading
+
+/// Run a function on several threads at once and wait for them all to
+/// finish. The calling thread does its share of the work too.
+/// \param n Number of threads.
+/// \param f Function to run, which takes the thread index as its parameter.
+
+static void ParallelFor(unsigned n, const std::function<void(unsigned)>& f){
+  std::vector<std::thread> threads; //all but the first thread
+
+  for(unsigned k=1; k<n; k++)
+    threads.push_back(std::thread(f, k));
+
+  f(0); //do the first share on this thread
+
+  for(std::thread& t: threads)
+    t.join();
+} //ParallelFor
+
+/// Apply a state relative to another one. A relative state is one that a
+/// turtle reaches from the identity state, which is at the origin with
+/// heading 0, lattice coordinates 0, and length 1. Its position is then in
+/// units of the length of the state that it is applied to, and is turned
+/// by that state's heading.
+/// \param f A state.
+/// \param g A state relative to f.
+/// \return The state that g is, relative to the start.
+
+CTurtle::Frame CTurtle::Compose(const Frame& f, const Frame& g) const{
+  Frame h; //result
+
+  h.m_fLength = f.m_fLength*g.m_fLength;
+  h.m_fAngle = f.m_fAngle + g.m_fAngle;
+
+  if(m_nHeadings > 0){ //heading indices add
+    h.m_nHeading = f.m_nHeading + g.m_nHeading;
+    if(h.m_nHeading >= m_nHeadings)h.m_nHeading -= m_nHeadings;
+  } //if
+
+  if(m_bLattice){ //turn g's lattice coordinates, exactly
+    const unsigned j = f.m_nHeading; //shorthand
+
+    h.m_nA = f.m_nA + g.m_nA*m_vStepA[j] + g.m_nB*m_vRotA[j];
+    h.m_nB = f.m_nB + g.m_nA*m_vStepB[j] + g.m_nB*m_vRotB[j];
+
+    h.m_fX = float(m_fStartX + h.m_nA*m_fUX + h.m_nB*m_fVX);
+    h.m_fY = float(m_fStartY + h.m_nA*m_fUY + h.m_nB*m_fVY);
+  } //if
+
+  else{ //turn and scale g's position
+    const float c = (m_nHeadings > 0)? m_vCos[f.m_nHeading]: cosf(f.m_fAngle);
+    const float s = (m_nHeadings > 0)? m_vSin[f.m_nHeading]: sinf(f.m_fAngle);
+
+    h.m_fX = f.m_fX + f.m_fLength*(g.m_fX*c - g.m_fY*s);
+    h.m_fY = f.m_fY + f.m_fLength*(g.m_fX*s + g.m_fY*c);
+  } //else
+
+  return h;
+} //Compose
+
+/// Read symbols using `m_nThreads` threads, with the same result as reading
+/// them one at a time except for floating point rounding. The symbols are
+/// split into chunks of `TURTLE_PARALLEL_CHUNK` symbols, and the chunks
+/// are dealt out to the threads in turn. The chunks do not depend on the
+/// number of threads, and neither does the order in which states are
+/// composed, so the rounding, and hence the result, is the same for any
+/// number of threads greater than 1.
+///
+/// First each chunk is read in parallel by a turtle that starts in the
+/// identity state (see Compose()). Every `]` that it cannot match is where
+/// the chunk pops a state saved by an earlier chunk, so the turtle notes
+/// its state there and goes back to the identity state. The chunk's
+/// summary is those states, the states that it leaves on its stack, and
+/// the state that it ends in, all relative to the last state that it pops.
+///
+/// Then a scan through the summaries, using this turtle's own state and
+/// stack, gives the state that each chunk starts in and the saved states
+/// that it pops. An unmatched `]` with nothing to pop is ignored, as it is
+/// by Read().
+///
+/// Finally each chunk is read in parallel by a turtle that starts in that
+/// state with those saved states, and the segments that they record are
+/// copied into place here.
+/// \param p Pointer to the symbols.
+/// \param n Number of symbols.
+
+void CTurtle::ReadParallel(const char* p, size_t n){
+  const size_t c = (n + TURTLE_PARALLEL_CHUNK - 1)/
+    TURTLE_PARALLEL_CHUNK; //number of chunks
+  const unsigned t = (unsigned)std::min((size_t)m_nThreads, c); //number of threads
+
+  std::vector<size_t> start(c + 1); //chunk boundaries
+
+  for(size_t k=0; k<=c; k++)
+    start[k] = std::min(k*TURTLE_PARALLEL_CHUNK, n);
+
+  //run f on every chunk, with thread j doing chunks j, j + t, j + 2t, etc.
+
+  auto ForEachChunk = [&](const std::function<void(size_t)>& f){
+    ParallelFor(t, [&](unsigned j){
+      for(size_t k=j; k<c; k+=t)
+        f(k);
+    }); //ParallelFor
+  }; //ForEachChunk
+
+  //step 1: summarize each chunk
+
+  class Summary{
+    public:
+      std::vector<Frame> m_vPops; ///< States at unmatched pops.
+      std::vector<Frame> m_vPushes; ///< States left on the stack.
+      Frame m_cEnd; ///< State at end.
+  }; //Summary
+
+  std::vector<Summary> summary(c); //one per chunk
+
+  Frame identity; //identity state
+  identity.m_fLength = 1;
+
+  ForEachChunk([&](size_t k){
+    CTurtle turtle(m_cDesc); //reads chunk k relative to its start
+    turtle.m_bRecord = false;
+    turtle.m_cState = identity;
+
+    for(size_t i=start[k]; i<start[k + 1]; i++)
+      if(m_pAction[(unsigned char)p[i]] == TURTLE_POP &&
+        turtle.m_vStack.empty()){ //pops an earlier chunk's state
+        summary[k].m_vPops.push_back(turtle.m_cState);
+        turtle.m_cState = identity;
+      } //if
+
+      else turtle.Read(p[i]);
+
+    summary[k].m_vPushes = std::move(turtle.m_vStack);
+    summary[k].m_cEnd = turtle.m_cState;
+  }); //ForEachChunk
+
+  //step 2: scan to get each chunk's start state and the saved states it pops
+
+  std::vector<CTurtle> turtle(c, CTurtle(m_cDesc)); //one per chunk
+
+  for(size_t k=0; k<c; k++){
+    const Summary& s = summary[k]; //shorthand
+    CTurtle& tk = turtle[k]; //shorthand
+
+    const size_t m = (s.m_vPops.size() < m_vStack.size())?
+      s.m_vPops.size(): m_vStack.size(); //number of pops that succeed
+
+    tk.m_cState = m_cState;
+    tk.m_vStack.assign(m_vStack.end() - m, m_vStack.end());
+    tk.m_nDepthBase = m_nDepthBase + m_vStack.size() - m;
+
+    Frame base = m_cState; //state that the chunk is relative to
+
+    for(const Frame& f: s.m_vPops){ //pop, or ignore the pop if nothing is saved
+      if(m_vStack.empty())
+        base = Compose(base, f);
+
+      else{
+        base = m_vStack.back();
+        m_vStack.pop_back();
+      } //else
+    } //for
+
+    for(const Frame& f: s.m_vPushes)
+      m_vStack.push_back(Compose(base, f));
+
+    m_cState = Compose(base, s.m_cEnd);
+  } //for
+
+  //step 3: read chunks in parallel from their start states
+
+  ForEachChunk([&](size_t k){
+    CTurtle& tk = turtle[k]; //shorthand
+
+    tk.m_nIndex = m_nIndex + start[k];
+    tk.m_fStartX = m_fStartX;
+    tk.m_fStartY = m_fStartY;
+    tk.m_bRecord = m_bRecord;
+    tk.m_bRecordLattice = m_bRecordLattice;
+
+    tk.m_fLeft = tk.m_fRight = tk.m_cState.m_fX;
+    tk.m_fTop = tk.m_fBottom = tk.m_cState.m_fY;
+
+    tk.Read(p + start[k], start[k + 1] - start[k]);
+  }); //ForEachChunk
+
+  m_nIndex += n;
+
+  //combine the bounds, and copy the segments into place after a prefix sum
+
+  std::vector<size_t> offset(c + 1, m_cSegments.GetSize()); //where segments go
+
+  for(size_t k=0; k<c; k++){
+    const CTurtle& tk = turtle[k]; //shorthand
+
+    if(tk.m_fLeft < m_fLeft)m_fLeft = tk.m_fLeft; //extend bounds
+    if(tk.m_fRight > m_fRight)m_fRight = tk.m_fRight;
+    if(tk.m_fTop < m_fTop)m_fTop = tk.m_fTop;
+    if(tk.m_fBottom > m_fBottom)m_fBottom = tk.m_fBottom;
+
+    offset[k + 1] = offset[k] + tk.m_cSegments.GetSize();
+  } //for
+
+  if(!m_bRecord)return; //no segments
+
+  const bool bLattice = m_bLattice && m_bRecordLattice; //lattice arrays too
+  CSegments& d = m_cSegments; //shorthand
+
+  d.m_vX0.resize(offset[c]); d.m_vY0.resize(offset[c]);
+  d.m_vX1.resize(offset[c]); d.m_vY1.resize(offset[c]);
+  d.m_vDepth.resize(offset[c]);
+  d.m_vIndex.resize(offset[c]);
+
+  if(bLattice){
+    d.m_vA0.resize(offset[c]); d.m_vB0.resize(offset[c]);
+    d.m_vA1.resize(offset[c]); d.m_vB1.resize(offset[c]);
+  } //if
+
+  ForEachChunk([&](size_t k){
+    const CSegments& s = turtle[k].m_cSegments; //chunk k's segments
+
+    auto Copy = [&](const auto& src, auto& dest){ //copy one array into place
+      std::copy(src.begin(), src.end(), dest.begin() + offset[k]);
+    }; //Copy
+
+    Copy(s.m_vX0, d.m_vX0); Copy(s.m_vY0, d.m_vY0);
+    Copy(s.m_vX1, d.m_vX1); Copy(s.m_vY1, d.m_vY1);
+    Copy(s.m_vDepth, d.m_vDepth);
+    Copy(s.m_vIndex, d.m_vIndex);
+
+    if(bLattice){
+      Copy(s.m_vA0, d.m_vA0); Copy(s.m_vB0, d.m_vB0);
+      Copy(s.m_vA1, d.m_vA1); Copy(s.m_vB1, d.m_vB1);
+    } //if
+  }); //ForEachChunk
+} //ReadParallel
+
+#pragma endregion Parallel reading
+
+///////////////////////////////////////////////////////////////////////////////
+// Reader functions
+
+#pragma region Reader functions
+
+/// Reader function for the segment buffer.
+/// \return The segments recorded since the last reset or clear.
+
+const CSegments& CTurtle::GetSegments() const{
+  return m_cSegments;
+} //GetSegments
+
+/// Discard the segments recorded so far, for example once they have been
+/// drawn. The turtle's state and the bounds are not changed.
+
+void CTurtle::ClearSegments(){
+  m_cSegments.Clear();
+} //ClearSegments
+
+/// Get the exact bounding box of the start point and every segment drawn
+/// since the last reset, including any that have been cleared.
+/// \param left [out] Smallest x coordinate.
+/// \param top [out] Smallest y coordinate.
+/// \param right [out] Largest x coordinate.
+/// \param bottom [out] Largest y coordinate.
+
+void CTurtle::GetBounds(float& left, float& top, float& right,
+  float& bottom) const
+{
+  left = m_fLeft;
+  top = m_fTop;
+  right = m_fRight;
+  bottom = m_fBottom;
+} //GetBounds
+
+/// Reader function for the lattice flag.
+/// \return true if the turtle keeps its position in lattice coordinates.
+
+bool CTurtle::IsLattice() const{
+  return m_bLattice;
+} //IsLattice
+
+/// Get the lattice basis, that is, the steps in floating point coordinates
+/// that lattice coordinates \f$(1, 0)\f$ and \f$(0, 1)\f$ stand for.
+/// Lattice point \f$(a, b)\f$ is at \f$S + aU + bV\f$, where \f$S\f$ is
+/// the start point given to Reset().
+/// \param ux [out] X coordinate of U.
+/// \param uy [out] Y coordinate of U.
+/// \param vx [out] X coordinate of V.
+/// \param vy [out] Y coordinate of V.
+
+void CTurtle::GetLatticeBasis(double& ux, double& uy, double& vx,
+  double& vy) const
+{
+  ux = m_fUX;
+  uy = m_fUY;
+  vx = m_fVX;
+  vy = m_fVY;
+} //GetLatticeBasis
+
+#pragma endregion Reader functions
@@ -0,0 +1,266 @@
+/// \file Turtle.h
+/// \brief Interface for the turtle graphics interpreter CTurtle.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#pragma once
+
+//This file and Turtle.cpp use only the standard library, not Windows or
+//GDI+, so that the turtle can be used on any platform.
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#define TURTLE_PI 3.14159265358979323846 ///< Pi, since M_PI is not standard.
+#define TURTLE_HEADINGS_MAX 360 ///< Most headings in a direction table.
+#define TURTLE_PARALLEL_MIN 65536 ///< Fewest symbols read in parallel.
+#define TURTLE_PARALLEL_CHUNK 32768 ///< Symbols per chunk when read in parallel.
+
+#define TURTLE_IGNORE 0 ///< Action of a symbol that the turtle ignores.
+#define TURTLE_DRAW 1 ///< Action of `F`, `L`, and `R`: draw a segment.
+#define TURTLE_LEFT 2 ///< Action of `+`: turn left.
+#define TURTLE_RIGHT 3 ///< Action of `-`: turn right.
+#define TURTLE_PUSH 4 ///< Action of `[`: save state.
+#define TURTLE_POP 5 ///< Action of `]`: restore state.
+
+/// \brief Turtle action of a symbol.
+/// \param c A symbol.
+/// \return The action that the turtle takes when it reads c.
+
+constexpr unsigned char TurtleAction(char c){
+  return (c == 'F' || c == 'L' || c == 'R')? TURTLE_DRAW:
+         (c == '+')? TURTLE_LEFT:
+         (c == '-')? TURTLE_RIGHT:
+         (c == '[')? TURTLE_PUSH:
+         (c == ']')? TURTLE_POP: TURTLE_IGNORE;
+} //TurtleAction
+
+///////////////////////////////////////////////////////////////////////////////
+// Turtle graphics descriptor
+
+#pragma region Turtle graphics descriptor
+
+/// \brief Turtle graphics descriptor.
+///
+/// A descriptor for turtle graphics that describes the start state of the
+/// turtle. Note that the angle delta is stored in radians (required by gdi+),
+/// but the constructor uses degrees (which is what is supplied by ABOP).
+///
+/// A descriptor can also point to tables made at compile time, such as those
+/// made by LPreset: the action of each symbol, and the sines and cosines of
+/// the headings. The turtle uses them instead of making its own, provided
+/// that the number of headings agrees with its own. They are not owned by
+/// the descriptor, and must outlive any turtle made from it.
+
+class TurtleDesc{
+  public:
+    float m_fAngleDelta = 0; ///< Line angle delta in radians.
+    float m_fLength = 8; ///< Line length.
+    float m_fLenMultiplier = 1; ///< Line length multiplier.
+    float m_fPointSize = 1; ///< Line point size.
+
+    const unsigned char* m_pAction = nullptr; ///< Action of each symbol, if baked.
+    unsigned m_nHeadings = 0; ///< Number of baked headings.
+    const float* m_pSin = nullptr; ///< Baked sine of each heading.
+    const float* m_pCos = nullptr; ///< Baked cosine of each heading.
+    
+    TurtleDesc(){}; ///< Default constructor.
+
+    /// \brief Constructor.
+    ///
+    /// \param angledelta Angle delta in degrees.
+    /// \param len Line length.
+
+    TurtleDesc(float angledelta, float len):
+      m_fAngleDelta(float(TURTLE_PI)*angledelta/180), m_fLength(len){
+    }; //constructor
+}; //TurtleDesc
+
+#pragma endregion Turtle graphics descriptor
+
+///////////////////////////////////////////////////////////////////////////////
+// Segment buffer
+
+#pragma region Segment buffer
+
+/// \brief Segment buffer.
+///
+/// The line segments drawn by the turtle, stored as a structure of arrays,
+/// that is, one array per field rather than one array of segments, so that
+/// a consumer that needs only some of the fields reads only those, and
+/// loops over them vectorize. Segment \f$i\f$ goes from
+/// (`m_vX0[i]`, `m_vY0[i]`) to (`m_vX1[i]`, `m_vY1[i]`). If the turtle is on
+/// a lattice and is asked to record lattice coordinates, then it also goes
+/// from (`m_vA0[i]`, `m_vB0[i]`) to (`m_vA1[i]`, `m_vB1[i]`) in those,
+/// otherwise the lattice arrays are empty.
+
+class CSegments{
+  public:
+    std::vector<float> m_vX0; ///< Start x coordinates.
+    std::vector<float> m_vY0; ///< Start y coordinates.
+    std::vector<float> m_vX1; ///< End x coordinates.
+    std::vector<float> m_vY1; ///< End y coordinates.
+    std::vector<unsigned> m_vDepth; ///< Bracket depths.
+    std::vector<unsigned long long> m_vIndex; ///< Indices of drawing symbols.
+    std::vector<long long> m_vA0; ///< Start lattice coordinates along U.
+    std::vector<long long> m_vB0; ///< Start lattice coordinates along V.
+    std::vector<long long> m_vA1; ///< End lattice coordinates along U.
+    std::vector<long long> m_vB1; ///< End lattice coordinates along V.
+
+    size_t GetSize() const; ///< Get number of segments.
+    void Clear(); ///< Remove all segments.
+    void Reserve(size_t n, bool bLattice=false); ///< Reserve space.
+}; //CSegments
+
+#pragma endregion Segment buffer
+
+///////////////////////////////////////////////////////////////////////////////
+// Turtle
+
+#pragma region Turtle
+
+/// \brief Turtle graphics interpreter.
+///
+/// Interprets the symbols of an L-system string as turtle commands and
+/// records the line segments that are drawn, without drawing them. `F`,
+/// `L`, and `R` move forward and draw a segment, `+` and `-` turn by the
+/// angle delta, `[` pushes the turtle's state and multiplies the length by
+/// the length multiplier, and `]` pops it. Other symbols are ignored, and so
+/// is a `]` without a matching `[`. The turtle starts out facing up, that
+/// is, towards negative \f$y\f$.
+///
+/// The string can be read in pieces of any size, so it can come from a
+/// stream. The segments are appended to a CSegments along with the bracket
+/// depth and the index of the symbol that drew them, and the exact bounding
+/// box of everything drawn is kept. A consumer that does not want to keep
+/// all of the segments can use them after each piece and then clear them
+/// with ClearSegments(), or turn off recording to get only the bounding box.
+///
+/// If a whole number of turns of the angle delta makes a full circle, as it
+/// does for 90, 60, 22.5, and 20 degrees, then the heading is kept as an
+/// index into a table of the sines and cosines of the possible headings.
+/// This takes the trigonometry out of drawing a segment, and the heading
+/// cannot drift however many turns are made. Other angles, and circles of
+/// more than `TURTLE_HEADINGS_MAX` turns, use a floating point heading.
+/// The symbols are looked up in a table of actions (see TurtleAction()),
+/// so reading one is a single indexed load and a dense switch.
+///
+/// If, in addition, every heading is a whole combination of two basis
+/// vectors \f$U\f$ and \f$V\f$ and the length multiplier is 1, then every
+/// point that the turtle visits is on the lattice that they generate. This
+/// is the case for 90 degrees (a square lattice) and 60 or 120 degrees (a
+/// triangular lattice, for example for the hexagonal Gosper curve). The
+/// turtle then keeps its position as exact integer lattice coordinates, and
+/// finds floating point coordinates from them only when it draws a segment,
+/// so the position cannot drift however long the string is. The lattice
+/// coordinates can be recorded too, for exact comparison of points.
+///
+/// Long pieces of the string can be read on several threads (see
+/// SetThreads()). Each symbol moves, turns, or scales the turtle, so its
+/// effect is a transform of the turtle's state, and a piece of string has
+/// a transform too, together with the brackets that it leaves unmatched.
+/// The piece is split into chunks of a fixed size, the transform of each
+/// chunk is found in parallel, a scan of those gives the state and stack
+/// that each chunk starts with, and then the chunks are read in parallel.
+/// Since the chunks do not depend on the number of threads, neither does
+/// the result.
+
+class CTurtle{
+  private:
+    /// \brief Stack frame.
+    ///
+    /// The turtle's state saved by `[`.
+
+    class Frame{
+      public:
+        float m_fX = 0; ///< X coordinate.
+        float m_fY = 0; ///< Y coordinate.
+        float m_fAngle = 0; ///< Heading, if there is no direction table.
+        unsigned m_nHeading = 0; ///< Heading, as an index into the direction table.
+        long long m_nA = 0; ///< Lattice coordinate along U.
+        long long m_nB = 0; ///< Lattice coordinate along V.
+        float m_fLength = 0; ///< Line length.
+    }; //Frame
+
+    TurtleDesc m_cDesc; ///< Turtle graphics descriptor.
+    const unsigned char* m_pAction = nullptr; ///< Action of each symbol.
+    Frame m_cState; ///< Current state.
+    std::vector<Frame> m_vStack; ///< Saved states.
+    size_t m_nDepthBase = 0; ///< Number of saved states below the stack.
+    unsigned long long m_nIndex = 0; ///< Index of next symbol.
+
+    unsigned m_nHeadings = 0; ///< Number of headings, 0 if no direction table.
+    unsigned m_nTurn = 0; ///< Change of heading index made by `-`.
+    std::vector<float> m_vSin; ///< Sine of each heading.
+    std::vector<float> m_vCos; ///< Cosine of each heading.
+
+    bool m_bLattice = false; ///< Whether the turtle is on a lattice.
+    std::vector<int> m_vStepA; ///< Lattice step along U for each heading.
+    std::vector<int> m_vStepB; ///< Lattice step along V for each heading.
+    double m_fUX = 0; ///< X coordinate of U.
+    double m_fUY = 0; ///< Y coordinate of U.
+    double m_fVX = 0; ///< X coordinate of V.
+    double m_fVY = 0; ///< Y coordinate of V.
+    std::vector<int> m_vRotA; ///< V turned by each heading, along U.
+    std::vector<int> m_vRotB; ///< V turned by each heading, along V.
+    double m_fStartX = 0; ///< X coordinate of lattice origin.
+    double m_fStartY = 0; ///< Y coordinate of lattice origin.
+
+    CSegments m_cSegments; ///< Segments drawn.
+    bool m_bRecord = true; ///< Whether to record segments.
+    bool m_bRecordLattice = false; ///< Whether to record lattice coordinates.
+
+    float m_fLeft = 0; ///< Smallest x coordinate.
+    float m_fTop = 0; ///< Smallest y coordinate.
+    float m_fRight = 0; ///< Largest x coordinate.
+    float m_fBottom = 0; ///< Largest y coordinate.
+
+    unsigned m_nThreads = 1; ///< Number of threads used by Read().
+
+    void MakeLattice(); ///< Make lattice steps if possible.
+    Frame Compose(const Frame& f, const Frame& g) const; ///< Apply a relative state.
+    void ReadParallel(const char* p, size_t n); ///< Read symbols in parallel.
+
+  public:
+    CTurtle(const TurtleDesc& d); ///< Constructor.
+
+    void Reset(float x=0, float y=0); ///< Start again.
+    void SetRecord(bool b); ///< Turn recording of segments on or off.
+    void SetRecordLattice(bool b); ///< Turn recording of lattice coordinates on or off.
+    void Reserve(size_t n); ///< Reserve space for segments.
+    void SetThreads(unsigned n); ///< Set number of threads.
+
+    void Read(char c); ///< Read a symbol.
+    void Read(const char* p, size_t n); ///< Read symbols.
+
+    const CSegments& GetSegments() const; ///< Get segments.
+    void ClearSegments(); ///< Discard segments.
+    void GetBounds(float& left, float& top, float& right, float& bottom) const; ///< Get bounds.
+
+    bool IsLattice() const; ///< Whether the turtle is on a lattice.
+    void GetLatticeBasis(double& ux, double& uy, double& vx, double& vy) const; ///< Get lattice basis.
+}; //CTurtle
+
+#pragma endregion Turtle
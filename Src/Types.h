@@ -26,67 +26,35 @@
 #pragma once
 
 #include "Includes.h"
+#include "Turtle.h"
 
 ///////////////////////////////////////////////////////////////////////////////
-// Turtle graphics descriptor
+// Hashing
 
-#pragma region Turtle graphics descriptor
+#pragma region Hashing
 
-/// \brief Turtle graphics descriptor.
-///
-/// A descriptor for turtle graphics that describes the start state of the
-/// turtle. Note that the angle delta is stored in radians (required by gdi+),
-/// but the constructor uses degrees (which is what is supplied by ABOP).
-
-class TurtleDesc{
-  public:
-    float m_fAngleDelta = 0; ///< Line angle delta in radians.
-    float m_fLength = 8; ///< Line length.
-    float m_fLenMultiplier = 1; ///< Line length multiplier.
-    float m_fPointSize = 1; ///< Line point size.
-    
-    TurtleDesc(){}; ///< Default constructor.
-
-    /// \brief Constructor.
-    ///
-    /// \param angledelta Angle delta in degrees.
-    /// \param len Line length.
-
-    TurtleDesc(float angledelta, float len):
-      m_fAngleDelta(float(M_PI)*angledelta/180), m_fLength(len){
-    }; //constructor
-}; //TurtleDesc
-
-#pragma endregion Turtle graphics descriptor
-
-///////////////////////////////////////////////////////////////////////////////
-// Stack frame
+#define FNV_OFFSET 14695981039346656037ULL ///< FNV-1a offset basis.
+#define FNV_PRIME 1099511628211ULL ///< FNV-1a prime.
 
-#pragma region Stack frame
-
-/// \brief Stack frame.
+/// \brief Hash bytes.
 ///
-/// A stack frame to be used in turtle graphics.
-
-class StackFrame{
-  public:
-    Gdiplus::PointF m_ptPos; ///< Position.
-    float m_fAngle = 0; ///< Rotation angle.
-    float m_fLength = 0; ///< Length.  
-    
-    /// \brief Default constructor.
-
-    StackFrame(){}; 
-
-    /// \brief Constructor.
-    ///
-    /// \param pos Position.
-    /// \param angle Angle.
-    /// \param len Line length.
-
-    StackFrame(Gdiplus::PointF pos, float angle, float len):
-      m_ptPos(pos), m_fAngle(angle), m_fLength(len){
-    }; //constructor
-}; //StackFrame
-
-#pragma endregion Stack frame
+/// Hash an array of bytes with the 64-bit FNV-1a hash. The hash of a
+/// sequence of objects is computed by passing the hash of the earlier
+/// objects as the starting value for the next one.
+/// \param p Pointer to bytes.
+/// \param n Number of bytes.
+/// \param h Starting value, defaults to the FNV-1a offset basis.
+/// \return The hash.
+
+inline ULONGLONG HashBytes(const void* p, size_t n, ULONGLONG h=FNV_OFFSET){
+  const unsigned char* q = (const unsigned char*)p; //bytes
+
+  for(size_t i=0; i<n; i++){
+    h ^= q[i];
+    h *= FNV_PRIME;
+  } //for
+
+  return h;
+} //HashBytes
+
+#pragma endregion Hashing
@@ -0,0 +1,481 @@
+/// \file Tests.cpp
+/// \brief Regression tests for the L-system generators.
+
+// MIT License
+//
+// Copyright (c) 2020 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+//This is a console program that checks that the ways of making or reading
+//the same generation of an L-system agree with each other. It prints each
+//check that fails, and exits with the number of failures.
+
+#include "Types.h"
+#include "Lsystem.h"
+#include "Growth.h"
+#include "Turtle.h"
+
+#include <tuple>
+
+static int g_nFailures = 0; ///< Number of checks that failed.
+
+/// Report a check that failed.
+/// \param b Result of the check.
+/// \param name Name of the L-system.
+/// \param what Description of the check.
+/// \param n Number of generations.
+
+static void Check(bool b, const char* name, const char* what, UINT n){
+  if(!b){
+    printf("FAILED: %s, %s, %u generations\n", name, what, n);
+    g_nFailures++;
+  } //if
+} //Check
+
+/// Load an L-system from narrow strings.
+/// \param lsys [out] An L-system, which is cleared first.
+/// \param root Root string.
+/// \param rules Productions, as pairs of left-hand side and right-hand side.
+
+static void Load(LSystem& lsys, const char* root,
+  const std::vector<std::pair<char, const char*>>& rules)
+{
+  lsys.Clear();
+
+  std::wstring w; //root, widened
+  for(const char* p=root; *p; p++)
+    w.push_back((wchar_t)(unsigned char)*p);
+
+  lsys.SetRoot(w);
+
+  for(const auto& r: rules)
+    lsys.AddRule(LProduction(r.first, r.second));
+} //Load
+
+///////////////////////////////////////////////////////////////////////////////
+// Compressed strings
+
+#pragma region Compressed strings
+
+/// Check that the compressed form of each generation reads back as the
+/// generated string, by ForEach(), by an Iterator, by GetSlice(), and by
+/// GetHash().
+/// \param name Name of the L-system.
+/// \param root Root string.
+/// \param rules Productions.
+/// \param nMax Largest number of generations to check.
+
+static void TestCompressed(const char* name, const char* root,
+  const std::vector<std::pair<char, const char*>>& rules, UINT nMax)
+{
+  LSystem flat; //generates flat strings
+  LSystem compressed; //generates compressed strings
+
+  Load(flat, root, rules);
+  Load(compressed, root, rules);
+
+  for(UINT n=0; n<=nMax; n++){
+    flat.Generate(n);
+    compressed.Compress(n);
+
+    const std::string& s = flat.GetString(); //expected
+    const LCompressed& c = compressed.GetCompressed(); //compressed form
+
+    std::string t; //read back by ForEach()
+    c.ForEach([&](const char ch){t.push_back(ch);});
+
+    const std::string u(c.begin(), c.end()); //read back by an Iterator
+
+    std::string v; //read back by GetSlice()
+    c.GetSlice(0, c.GetLength(), v);
+
+    Check(c.GetLength() == s.size(), name, "compressed length", n);
+    Check(t == s, name, "compressed ForEach()", n);
+    Check(u == s, name, "compressed Iterator", n);
+    Check(v == s, name, "compressed GetSlice()", n);
+    Check(c.GetHash() == HashBytes(s.data(), s.size()),
+      name, "compressed GetHash()", n);
+  } //for
+} //TestCompressed
+
+/// Check compressed strings of L-systems with empty right-hand sides and
+/// an empty root, whose DAGs have nodes with empty expansions.
+
+static void TestCompressed(){
+  TestCompressed("Erasing", "AB", {{'A', "AB"}, {'B', ""}}, 6);
+  TestCompressed("Erasing with constants", "A+B",
+    {{'A', "B[A]-A"}, {'B', ""}}, 6);
+  TestCompressed("Vanishing", "A", {{'A', ""}}, 3);
+  TestCompressed("Empty root", "", {{'A', "AA"}}, 3);
+  TestCompressed("Plant D", "X", {{'X', "F[+X]F[-X]+X"}, {'F', "FF"}}, 6);
+  TestCompressed("Two productions", "F", {{'F', "FFX"}, {'F', "FFFX"}}, 8);
+} //TestCompressed
+
+#pragma endregion Compressed strings
+
+///////////////////////////////////////////////////////////////////////////////
+// Deterministic strings
+
+#pragma region Deterministic strings
+
+/// Check that a generation of a deterministic L-system comes out the same
+/// whether it is rewritten or expanded from the cache, on one thread or
+/// several, that its predicted length is exact, and that an LDerivation
+/// and GetSymbol() read the same symbols. Only the first production for a
+/// symbol is ever applied, so a later, longer one must not change any of
+/// these.
+/// \param name Name of the L-system.
+/// \param root Root string.
+/// \param rules Productions.
+/// \param n Number of generations, enough to be rewritten in parallel.
+
+static void TestDeterministic(const char* name, const char* root,
+  const std::vector<std::pair<char, const char*>>& rules, UINT n)
+{
+  LSystem lsys[4]; //rewritten, cached, rewritten and cached on 4 threads
+
+  for(LSystem& l: lsys)
+    Load(l, root, rules);
+
+  lsys[0].SetMemoize(false);
+  lsys[2].SetMemoize(false);
+  lsys[2].SetThreads(4);
+  lsys[3].SetThreads(4);
+
+  for(LSystem& l: lsys)
+    l.Generate(n);
+
+  const std::string& s = lsys[0].GetString(); //expected
+
+  Check(s.size() >= LSYS_PARALLEL_MIN, name, "long enough for threads", n);
+  Check(lsys[0].GetPredictedLength(n) == s.size(), name, "predicted length", n);
+  Check(lsys[1].GetString() == s, name, "cached", n);
+  Check(lsys[2].GetString() == s, name, "rewritten on 4 threads", n);
+  Check(lsys[3].GetString() == s, name, "cached on 4 threads", n);
+
+  LDerivation d(lsys[0], n); //lazy derivation
+  std::string t; //read by Next()
+  for(char c; d.Next(c);)t.push_back(c);
+  Check(t == s, name, "LDerivation::Next()", n);
+
+  bool bSeek = true; //whether every seek found the right symbol
+
+  for(size_t k=0; k<s.size(); k+=1 + s.size()/37){ //sample some symbols
+    char c = 0; //symbol at index k
+    bSeek = bSeek && d.Seek(k) && d.Next(c) && c == s[k];
+    bSeek = bSeek && lsys[0].GetSymbol(n, k, c) && c == s[k];
+  } //for
+
+  char c = 0; //last symbol
+  bSeek = bSeek && lsys[0].GetSymbol(n, s.size() - 1, c) && c == s.back();
+  bSeek = bSeek && !d.Seek(s.size());
+  Check(bSeek, name, "LDerivation::Seek()", n);
+} //TestDeterministic
+
+/// Check deterministic strings, including ones with two productions for
+/// the same symbol, of which only the first is applied.
+
+static void TestDeterministic(){
+  TestDeterministic("Plant D", "X", {{'X', "F[+X]F[-X]+X"}, {'F', "FF"}}, 10);
+  TestDeterministic("Two productions", "F", {{'F', "FFX"}, {'F', "FFFX"}}, 16);
+  TestDeterministic("Long second production", "F",
+    {{'F', "FFX"}, {'F', "FFFFFFFFFFFFFFFFFFFFX"}}, 16);
+} //TestDeterministic
+
+#pragma endregion Deterministic strings
+
+///////////////////////////////////////////////////////////////////////////////
+// Stochastic strings
+
+#pragma region Stochastic strings
+
+/// Read the result of an L-system by streaming it through a ring buffer on
+/// another thread, as CMain::Draw() does.
+/// \param lsys An L-system that has been generated.
+/// \return The streamed string.
+
+static std::string ReadStream(LSystem& lsys){
+  CRingBuffer<char> ring(1 << 12); //small, so that the producer waits
+  std::thread producer([&](){lsys.Stream(ring);});
+
+  std::string s; //result
+  char buf[1000]; //symbols popped at a time
+
+  for(size_t n; (n = ring.Pop(buf, sizeof(buf))) > 0;)
+    s.append(buf, n);
+
+  producer.join();
+  return s;
+} //ReadStream
+
+/// Check that each generation of a stochastic L-system comes out the same
+/// for the same seed however it is made: on one thread or several, spilled
+/// to a file, streamed, read lazily by an LDerivation, or sampled with
+/// GetSymbol().
+/// \param name Name of the L-system.
+/// \param root Root string.
+/// \param rules Productions, as left-hand side, right-hand side, and
+/// probability.
+/// \param nMax Largest number of generations to check.
+
+static void TestStochastic(const char* name, const char* root,
+  const std::vector<std::tuple<char, const char*, float>>& rules, UINT nMax)
+{
+  const int SEED = 7; //seed for all of the L-systems
+
+  LSystem lsys[4]; //serial, parallel, spilled, deferred
+
+  for(LSystem& l: lsys){
+    l.Clear();
+
+    std::wstring w; //root, widened
+    for(const char* p=root; *p; p++)
+      w.push_back((wchar_t)(unsigned char)*p);
+
+    l.SetRoot(w);
+
+    for(const auto& r: rules)
+      l.AddRule(LProduction(std::get<0>(r), std::get<1>(r), std::get<2>(r)));
+
+    l.SetSeed(SEED);
+  } //for
+
+  lsys[1].SetThreads(3);
+  lsys[2].SetMemoryBudget(16);
+
+  for(UINT n=0; n<=nMax; n++){
+    lsys[0].Generate(n);
+    lsys[1].Generate(n);
+    lsys[2].Generate(n);
+    lsys[3].Generate(n, true);
+
+    const std::string s = lsys[0].GetString(); //expected
+
+    Check(lsys[1].GetString() == s, name, "stochastic on 3 threads", n);
+    Check(lsys[2].IsSpilled() == (s.size() > 16), name, "stochastic spill", n);
+    Check(ReadStream(lsys[2]) == s, name, "stochastic spilled", n);
+    Check(ReadStream(lsys[3]) == s, name, "stochastic deferred", n);
+
+    lsys[0].SetSeed(SEED + 1); //generate something else in between
+    lsys[0].Generate(n);
+    lsys[0].SetSeed(SEED);
+    lsys[0].Generate(n);
+    Check(lsys[0].GetString() == s, name, "stochastic same seed", n);
+
+    LDerivation d(lsys[0], n); //lazy derivation
+    std::string t; //read by Next()
+    for(char c; d.Next(c);)t.push_back(c);
+    Check(t == s, name, "stochastic LDerivation::Next()", n);
+
+    bool bSeek = true; //whether every seek found the right symbol
+    
+    for(size_t k=0; k<s.size(); k+=1 + s.size()/37){ //sample some symbols
+      char c = 0; //symbol at index k
+      bSeek = bSeek && d.Seek(k) && d.Next(c) && c == s[k];
+      bSeek = bSeek && lsys[0].GetSymbol(n, k, c) && c == s[k];
+    } //for
+
+    bSeek = bSeek && !d.Seek(s.size());
+    Check(bSeek, name, "stochastic LDerivation::Seek()", n);
+  } //for
+} //TestStochastic
+
+/// Check stochastic strings, including ones long enough to be derived on
+/// several threads, and ones with empty right-hand sides.
+
+static void TestStochastic(){
+  TestStochastic("Branching", "F", {
+    std::make_tuple('F', "F[+F]F[-F]F", 0.33f),
+    std::make_tuple('F', "F[+F]F", 0.33f),
+    std::make_tuple('F', "F[-F]F", 0.34f)}, 8);
+
+  TestStochastic("Stochastic erasing", "A+B", {
+    std::make_tuple('A', "AB[A]", 0.5f),
+    std::make_tuple('A', "", 0.5f),
+    std::make_tuple('B', "BA", 0.7f),
+    std::make_tuple('B', "-", 0.3f)}, 10);
+} //TestStochastic
+
+#pragma endregion Stochastic strings
+
+///////////////////////////////////////////////////////////////////////////////
+// Growth predictions
+
+#pragma region Growth predictions
+
+/// Check that the exact symbol and segment counts predicted for each
+/// generation of a deterministic L-system are those of the generated
+/// string.
+/// \param name Name of the L-system.
+/// \param root Root string.
+/// \param rules Productions.
+/// \param nMax Largest number of generations to check.
+
+static void TestExactCounts(const char* name, const char* root,
+  const std::vector<std::pair<char, const char*>>& rules, UINT nMax)
+{
+  LSystem lsys; //the L-system
+  Load(lsys, root, rules);
+
+  const LGrowth growth(lsys); //predictor
+  const std::string& symbols = growth.GetSymbols(); //symbols by index
+
+  for(UINT n=0; n<=nMax; n++){
+    lsys.Generate(n);
+    const std::string& s = lsys.GetString(); //generated string
+
+    std::vector<ULONGLONG> v; //predicted counts
+    bool bCounts = growth.GetExactCounts(n, v) && v.size() == symbols.size();
+
+    for(size_t a=0; bCounts && a<v.size(); a++)
+      bCounts = v[a] == (ULONGLONG)std::count(s.begin(), s.end(), symbols[a]);
+
+    ULONGLONG segments = 0; //predicted segments
+    const ULONGLONG drawn = std::count_if(s.begin(), s.end(),
+      [](char c){return c == 'F' || c == 'L' || c == 'R';}); //actual segments
+
+    Check(bCounts, name, "GetExactCounts()", n);
+    Check(growth.GetExactSegments(n, segments) && segments == drawn,
+      name, "GetExactSegments()", n);
+  } //for
+} //TestExactCounts
+
+/// Check exact counts, including for a deterministic L-system with two
+/// productions for the same symbol, of which only the first is applied,
+/// and check that a stochastic L-system has none.
+
+static void TestGrowth(){
+  TestExactCounts("Plant D", "X", {{'X', "F[+X]F[-X]+X"}, {'F', "FF"}}, 8);
+  TestExactCounts("Two productions", "FX",
+    {{'F', "F+F"}, {'F', "FFF"}, {'X', "XF"}}, 8);
+
+  LSystem lsys; //a stochastic L-system
+  Load(lsys, "F", {});
+  lsys.AddRule(LProduction('F', "F[+F]F", 0.5f));
+  lsys.AddRule(LProduction('F', "F", 0.5f));
+
+  const LGrowth growth(lsys); //predictor
+  std::vector<ULONGLONG> v; //counts
+  ULONGLONG segments = 1; //count of segments
+
+  Check(!growth.GetExactCounts(3, v) && v.empty(),
+    "Stochastic", "no GetExactCounts()", 3);
+  Check(!growth.GetExactSegments(3, segments) && segments == 0,
+    "Stochastic", "no GetExactSegments()", 3);
+} //TestGrowth
+
+#pragma endregion Growth predictions
+
+///////////////////////////////////////////////////////////////////////////////
+// Turtle
+
+#pragma region Turtle
+
+/// Check that reading a string in parallel draws the same segments as
+/// reading it on one thread. On a lattice the positions are exact, so the
+/// segments must be identical. Otherwise the chunks are composed with
+/// different floating point rounding, so the positions need only be close,
+/// but they must be identical for any number of threads greater than 1,
+/// since the chunks do not depend on it.
+/// \param name Name of the L-system.
+/// \param root Root string.
+/// \param rules Productions.
+/// \param n Number of generations, enough for several chunks.
+/// \param angle Angle delta in degrees.
+
+static void TestTurtle(const char* name, const char* root,
+  const std::vector<std::pair<char, const char*>>& rules, UINT n, float angle)
+{
+  LSystem lsys; //the L-system
+  Load(lsys, root, rules);
+  lsys.Generate(n);
+
+  const std::string s = lsys.GetString() + "]]"; //with unmatched pops
+  const TurtleDesc d(angle, 8.0f); //turtle graphics descriptor
+
+  auto Read = [&](unsigned t, CSegments& segments){ //read s on t threads
+    CTurtle turtle(d);
+    turtle.SetRecordLattice(true);
+    turtle.SetThreads(t);
+    turtle.Read(s.data(), s.size());
+    segments = turtle.GetSegments();
+    return turtle.IsLattice();
+  }; //Read
+
+  CSegments serial, parallel[3]; //segments read on 1, 2, 3, and 8 threads
+  const bool bLattice = Read(1, serial);
+  Read(2, parallel[0]);
+  Read(3, parallel[1]);
+  Read(8, parallel[2]);
+
+  auto Same = [](const CSegments& a, const CSegments& b){ //identical
+    return a.m_vX0 == b.m_vX0 && a.m_vY0 == b.m_vY0 &&
+      a.m_vX1 == b.m_vX1 && a.m_vY1 == b.m_vY1 &&
+      a.m_vDepth == b.m_vDepth && a.m_vIndex == b.m_vIndex &&
+      a.m_vA0 == b.m_vA0 && a.m_vB0 == b.m_vB0 &&
+      a.m_vA1 == b.m_vA1 && a.m_vB1 == b.m_vB1;
+  }; //Same
+
+  auto Close = [](const std::vector<float>& a, const std::vector<float>& b){
+    if(a.size() != b.size())return false;
+
+    for(size_t i=0; i<a.size(); i++)
+      if(fabsf(a[i] - b[i]) > 1e-3f*(1 + fabsf(a[i])))return false;
+
+    return true;
+  }; //Close
+
+  const CSegments& p = parallel[0]; //shorthand
+  const bool bClose = Close(serial.m_vX0, p.m_vX0) &&
+    Close(serial.m_vY0, p.m_vY0) && Close(serial.m_vX1, p.m_vX1) &&
+    Close(serial.m_vY1, p.m_vY1) && serial.m_vDepth == p.m_vDepth &&
+    serial.m_vIndex == p.m_vIndex;
+
+  Check(s.size() > 2*TURTLE_PARALLEL_CHUNK, name, "several chunks", n);
+  Check(bLattice? Same(serial, p): bClose, name, "parallel turtle", n);
+  Check(Same(p, parallel[1]) && Same(p, parallel[2]),
+    name, "turtle on 2, 3, and 8 threads", n);
+} //TestTurtle
+
+/// Check parallel reading on and off a lattice.
+
+static void TestTurtle(){
+  TestTurtle("Plant D", "X", {{'X', "F[+X]F[-X]+X"}, {'F', "FF"}}, 10, 20.0f);
+  TestTurtle("Plant E", "X", {{'X', "F[+X][-X]FX"}, {'F', "FF"}}, 10, 25.7f);
+  TestTurtle("Hexagonal Gosper", "L",
+    {{'L', "L+R++R-L--LL-R+"}, {'R', "-L+RR++R+L--L-R"}}, 6, 60.0f);
+} //TestTurtle
+
+#pragma endregion Turtle
+
+/// Run the tests.
+/// \return Number of checks that failed.
+
+int main(){
+  TestCompressed();
+  TestDeterministic();
+  TestStochastic();
+  TestGrowth();
+  TestTurtle();
+
+  printf("%d failures\n", g_nFailures);
+  return g_nFailures;
+} //main